@@ -0,0 +1,400 @@
+/**
+ *  \file ponfclient.cpp
+ *  \brief This file defines functions from ponfclient.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "ponfclient.h"
+#include "../ShutteControl_I2C/shutter.h"
+
+#include <stdio.h>
+#include <climits>
+
+//! Shooting commands, in the PONFSpeed order
+static const char* const shotCommand[] = {
+  SHOT_8S, SHOT_4S, SHOT_2S, SHOT_1S, SHOT_2, SHOT_4, SHOT_8, SHOT_15,
+  SHOT_30, SHOT_60, SHOT_125, SHOT_250, SHOT_400, SHOT_1000
+};
+
+PONFClient::PONFClient(PONFTransport &link) : link(link) {
+}
+
+PONFClient::~PONFClient() {
+  end();
+}
+
+bool PONFClient::begin(void) {
+  end();
+
+  if(!link.open())
+    return false;
+
+  running = true;
+  sender = std::thread(&PONFClient::sendLoop, this);
+  receiver = std::thread(&PONFClient::receiveLoop, this);
+
+  return true;
+}
+
+void PONFClient::end(void) {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    running = false;
+  }
+  changed.notify_all();
+
+  if(sender.joinable())
+    sender.join();
+  if(receiver.joinable())
+    receiver.join();
+  link.close();
+
+  // Nothing will satisfy the pending commands anymore
+  for(auto &p : queue)
+    p.reply.set_value(PONFReply{ PONF_STATE_ERROR, p.seq, 0, "" });
+  queue.clear();
+  for(auto &p : inFlight)
+    p.second.reply.set_value(PONFReply{ PONF_STATE_ERROR, p.first, 0, "" });
+  inFlight.clear();
+  frameSeqs.clear();
+}
+
+std::future<PONFReply> PONFClient::command(const std::string &cmd) {
+  return enqueue(cmd, false);
+}
+
+std::future<PONFReply> PONFClient::enqueue(const std::string &cmd, bool hold) {
+  Pending p;
+  std::future<PONFReply> f;
+
+  if( cmd.empty() || (cmd.find_first_of(std::string(1, CMD_SEP) + "\r\n") != std::string::npos) ||
+      (cmd[0] == CMD_SEQ_PREFIX) )
+    return error();
+
+  {
+    std::lock_guard<std::mutex> l(lock);
+    if(!running)
+      return error();
+
+    p.seq = nextSeq;
+    nextSeq = (nextSeq + 1) % PONF_SEQ_MODULO;
+    p.cmd = CMD_SEQ_PREFIX + std::to_string(p.seq) + CMD_SEQ_END + cmd;
+    p.hold = hold;
+    p.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    f = p.reply.get_future();
+    queue.push_back(std::move(p));
+  }
+  changed.notify_all();
+
+  return f;
+}
+
+void PONFClient::beginBatch(void) {
+  std::lock_guard<std::mutex> l(lock);
+  batching = true;
+}
+
+void PONFClient::endBatch(void) {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    batching = false;
+  }
+  changed.notify_all();
+}
+
+std::future<PONFReply> PONFClient::error(void) {
+  std::promise<PONFReply> p;
+
+  p.set_value(PONFReply{ PONF_STATE_ERROR, -1, 0, "" });
+
+  return p.get_future();
+}
+
+// ===============================================================
+// Link threads
+// ===============================================================
+
+bool PONFClient::canSend(void) {
+  if(queue.empty() || batching || holding)
+    return false;
+
+  // One frame at a time or up to the window commands
+  if(link.window() == 0)
+    return inFlight.empty();
+
+  return inFlight.size() < link.window();
+}
+
+void PONFClient::sendLoop(void) {
+  std::unique_lock<std::mutex> l(lock);
+  std::string frame;
+  unsigned int room;
+  bool sent;
+
+  while(running) {
+    changed.wait(l, [this] { return !running || canSend(); });
+    if(!running)
+      break;
+
+    // All the commands queued that fit the frame and the window. Every
+    // command is terminated by the separator, so two serial lines read
+    // together by the controller are still split correctly
+    frame.clear();
+    frameSeqs.clear();
+    room = (link.window() == 0) ? UINT_MAX : (link.window() - inFlight.size());
+    while(!queue.empty() && (room > 0)) {
+      Pending &p = queue.front();
+      if(frame.size() + p.cmd.size() + 1 > link.maxFrame()) {
+        if(!frame.empty())
+          break;
+        // Too long for any frame
+        p.reply.set_value(PONFReply{ PONF_STATE_ERROR, p.seq, 0, "" });
+        queue.pop_front();
+        continue;
+      }
+      frame += p.cmd;
+      frame += CMD_SEP;
+      frameSeqs.push_back(p.seq);
+      holding = p.hold;
+      inFlight.emplace(p.seq, std::move(p));
+      queue.pop_front();
+      room--;
+      if(holding)
+        break;
+    }
+    if(frameSeqs.empty())
+      continue;
+
+    lastFrame = frame;
+    frames++;
+    commands += frameSeqs.size();
+
+    l.unlock();
+    sent = link.send(frame);
+    l.lock();
+
+    if(!sent) {
+      for(long seq : frameSeqs)
+        complete(seq, PONF_STATE_ERROR, 0);
+    }
+    changed.notify_all();
+  }
+}
+
+void PONFClient::receiveLoop(void) {
+  std::string status;
+  bool received;
+
+  for(;;) {
+    {
+      std::unique_lock<std::mutex> l(lock);
+      // On I2C the status register is read only while a frame is running
+      if(link.window() == 0)
+        changed.wait(l, [this] { return !running || !inFlight.empty(); });
+      if(!running)
+        break;
+    }
+
+    received = link.receive(status, PONF_RECEIVE_MS);
+
+    {
+      std::lock_guard<std::mutex> l(lock);
+      if(received)
+        dispatch(status);
+      expire();
+    }
+    changed.notify_all();
+  }
+}
+
+void PONFClient::dispatch(const std::string &status) {
+  char state;
+  long seq;
+  unsigned long us;
+  int len;
+  size_t j, k;
+
+  // I2C frame discarded because the controller was still busy
+  if(status == CMD_BUSY) {
+    if(!inFlight.empty() && !lastFrame.empty()) {
+      resent++;
+      link.send(lastFrame);
+    }
+    return;
+  }
+
+  // Acknowledge: <state> <seq> <micros>. The controller executes one
+  // command at a time, so the other lines are messages of the command
+  // accepted last
+  len = 0;
+  if( (sscanf(status.c_str(), "%c %ld %lu%n", &state, &seq, &us, &len) != 3) ||
+      ((state != CMD_ACK_ACCEPTED) && (state != CMD_ACK_COMPLETED) && (state != CMD_ACK_FAILED)) ) {
+    auto p = inFlight.find(currentSeq);
+    if(p != inFlight.end())
+      p->second.output += status + "\n";
+    return;
+  }
+  if(state == CMD_ACK_ACCEPTED) {
+    currentSeq = seq;
+    return;
+  }
+
+  // The I2C status register ends with the status of all the frame commands
+  if( (len < (int)status.size()) && !frameSeqs.empty() && (seq == frameSeqs.back()) ) {
+    k = 0;
+    for(j = len; (j < status.size()) && (k < frameSeqs.size()); j++) {
+      if(status[j] == CMD_STATUS_OK)
+        complete(frameSeqs[k++], CMD_ACK_COMPLETED, us);
+      else if(status[j] == CMD_STATUS_FAIL)
+        complete(frameSeqs[k++], CMD_ACK_FAILED, us);
+    }
+  }
+
+  complete(seq, state, us);
+}
+
+void PONFClient::complete(long seq, char state, unsigned long micros) {
+  auto p = inFlight.find(seq);
+
+  // Already satisfied, expired or sent by someone else
+  if(p == inFlight.end())
+    return;
+
+  p->second.reply.set_value(PONFReply{ state, seq, micros, p->second.output });
+  inFlight.erase(p);
+  if(completed)
+    completed();
+}
+
+void PONFClient::expire(void) {
+  auto now = std::chrono::steady_clock::now();
+
+  for(auto p = inFlight.begin(); p != inFlight.end(); ) {
+    if(p->second.deadline < now) {
+      timeouts++;
+      p->second.reply.set_value(PONFReply{ PONF_STATE_TIMEOUT, p->first, 0, "" });
+      p = inFlight.erase(p);
+      if(completed)
+        completed();
+    }
+    else
+      ++p;
+  }
+}
+
+// ===============================================================
+// Typed commands
+// ===============================================================
+
+std::future<PONFReply> PONFClient::shot(PONFSpeed speed) {
+  if( (speed < PONF_8S) || (speed > PONF_1000) )
+    return error();
+
+  return command(shotCommand[speed]);
+}
+
+std::future<PONFReply> PONFClient::burst(PONFSpeed speed) {
+  switch(speed) {
+    case PONF_125:
+      return command(SHOT_MULTI125);
+    case PONF_250:
+      return command(SHOT_MULTI250);
+    case PONF_400:
+      return command(SHOT_MULTI400);
+    case PONF_1000:
+      return command(SHOT_MULTI1000);
+    default:
+      return error();
+  }
+}
+
+std::future<PONFReply> PONFClient::arm(void) {
+  return command(SH_ARM);
+}
+
+std::future<PONFReply> PONFClient::fire(unsigned int exposure) {
+  if(exposure == 0)
+    return error();
+
+  return command(SH_FIRE + std::to_string(exposure));
+}
+
+std::future<PONFReply> PONFClient::cycle(void) {
+  return command(SH_MOTOR_CYCLE);
+}
+
+std::future<PONFReply> PONFClient::timelapse(unsigned long interval, unsigned long count, unsigned int exposure) {
+  if( (interval == 0) || (exposure == 0) )
+    return error();
+
+  return command(TL_START + std::to_string(interval) + CMD_PARAM_SEP + std::to_string(count) +
+    CMD_PARAM_SEP + std::to_string(exposure));
+}
+
+std::future<PONFReply> PONFClient::timelapseStop(void) {
+  return command(TL_STOP);
+}
+
+std::future<PONFReply> PONFClient::triggerArm(unsigned int exposure) {
+  if(exposure == 0)
+    return error();
+
+  return command(TRG_ARM + std::to_string(exposure));
+}
+
+std::future<PONFReply> PONFClient::triggerDisarm(void) {
+  return command(TRG_DISARM);
+}
+
+std::future<PONFReply> PONFClient::motorMove(int m, int dir, unsigned int ms) {
+  if( (m <= SH_MOTOR) || (m > MAX_MOTORS) ||
+      ((dir != MOTOR_DIRECTION_CW) && (dir != MOTOR_DIRECTION_CCW)) ||
+      (ms == 0) || (ms > MOTOR_MOVE_MAX_MS) )
+    return error();
+
+  return command(MOTOR_MOVE + std::to_string(m) + CMD_PARAM_SEP + std::to_string(dir) +
+    CMD_PARAM_SEP + std::to_string(ms));
+}
+
+std::future<PONFReply> PONFClient::motorPWM(int m, unsigned int hz, uint8_t dc) {
+  if( (m < 1) || (m > MAX_MOTORS) )
+    return error();
+
+  return command(MOTOR_PWM + std::to_string(m) + CMD_PARAM_SEP + std::to_string(hz) +
+    CMD_PARAM_SEP + std::to_string(dc));
+}
+
+std::future<PONFReply> PONFClient::motorStopMode(int m, int mode, unsigned int ms) {
+  if( (m < 0) || (m > MAX_MOTORS) || (mode < MOTOR_STOP_COAST) || (mode > MOTOR_STOP_TIMED) ||
+      (ms > MOTOR_BRAKE_MAX_MS) )
+    return error();
+
+  return command(MOTOR_STOP_MODE + std::to_string(m) + CMD_PARAM_SEP + std::to_string(mode) +
+    CMD_PARAM_SEP + std::to_string(ms));
+}
+
+std::future<PONFReply> PONFClient::profileLoad(int profile) {
+  if( (profile < 1) || (profile > PONF_PROFILES) )
+    return error();
+
+  return command(PROF_LOAD + std::to_string(profile));
+}
+
+bool PONFClient::setBaud(unsigned long bps) {
+  std::future<PONFReply> r;
+  bool ok;
+
+  // The controller changes the speed after the acknowledge, the
+  // frames sent meanwhile would be lost
+  r = enqueue(SER_BAUD + std::to_string(bps), true);
+  ok = r.get().ok() && link.setSpeed(bps);
+
+  {
+    std::lock_guard<std::mutex> l(lock);
+    holding = false;
+  }
+  changed.notify_all();
+
+  return ok;
+}
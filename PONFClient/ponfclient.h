@@ -0,0 +1,306 @@
+/**
+ *  \file ponfclient.h
+ *  \brief Master side client of the shutter controller for the Raspberry PI CM3
+ *
+ *  Every command is tagged with a sequence ID and returns a future that
+ *  is satisfied by the controller acknowledge, so the application never
+ *  parses the command strings and the acknowledges by itself.
+ *
+ *  The commands are pipelined: a command can be sent before the previous
+ *  ones complete, up to the window of the link. The commands queued while
+ *  the link is busy, or between beginBatch() and endBatch(), are sent
+ *  together in a single frame separated by CMD_SEP.
+ *
+ *  The command names and the parameters limits come from the controller
+ *  headers, so the client is always aligned with the firmware.
+ *
+ *  \code
+ *  PONFSerial link("/dev/ttyAMA0");
+ *  PONFClient client(link);
+ *
+ *  client.begin();
+ *  client.arm();
+ *  std::future<PONFReply> r = client.fire(100);
+ *  if(!r.get().ok())
+ *    ...
+ *  \endcode
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _PONFCLIENT
+#define _PONFCLIENT
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+#include "../ShutteControl_I2C/commands.h"
+#include "../ShutteControl_I2C/motor.h"
+#include "ponftransport.h"
+
+#define PONF_SEQ_MODULO 1000    ///< Sequence IDs wrap, short IDs keep the I2C frames small
+#define PONF_TIMEOUT_MS 30000   ///< Default max time (ms) for a command to complete
+#define PONF_RECEIVE_MS 20      ///< Max wait (ms) of the receiver before checking the timeouts
+#define PONF_PROFILES 3         ///< Profiles stored by the controller (PROFILE_SLOTS)
+
+#define PONF_STATE_TIMEOUT 'T'  ///< Reply state: no acknowledge within the timeout
+#define PONF_STATE_ERROR 'E'    ///< Reply state: not sent (link closed, command too long or not valid)
+
+/**
+ * Command result
+ */
+struct PONFReply {
+  char state;             ///< CMD_ACK_COMPLETED, CMD_ACK_FAILED, PONF_STATE_TIMEOUT or PONF_STATE_ERROR
+  long seq;               ///< Sequence ID of the command
+  unsigned long micros;   ///< Controller time (us) of the acknowledge
+  std::string output;     ///< Messages of the command, one per line (serial only)
+
+  //! \brief The command has been completed
+  bool ok(void) const { return state == CMD_ACK_COMPLETED; }
+};
+
+/**
+ * Shutter speeds of the shooting commands
+ */
+enum PONFSpeed {
+  PONF_8S, PONF_4S, PONF_2S, PONF_1S, PONF_2, PONF_4, PONF_8, PONF_15,
+  PONF_30, PONF_60, PONF_125, PONF_250, PONF_400, PONF_1000
+};
+
+/**
+ * \brief Client of the shutter controller
+ */
+class PONFClient {
+  public:
+
+    //! Frames sent
+    unsigned long frames = 0;
+    //! Commands sent
+    unsigned long commands = 0;
+    //! Commands without acknowledge within the timeout
+    unsigned long timeouts = 0;
+    //! Frames sent again because the controller was busy
+    unsigned long resent = 0;
+
+    /**
+     * \param link The link to the controller, should live as long as the client
+     */
+    PONFClient(PONFTransport &link);
+    ~PONFClient();
+
+    /**
+     * \brief Open the link and start the sender and receiver threads
+     *
+     * \return false if the link can't be opened
+     */
+    bool begin(void);
+
+    //! \brief Stop the threads and close the link. The pending commands fail
+    void end(void);
+
+    /**
+     * \brief Set a function called by the receiver every time some commands
+     * complete, e.g. to wake up an event loop waiting for the futures.
+     * Should be set before begin()
+     *
+     * \param notify The function, called with the client state locked
+     */
+    void onComplete(std::function<void(void)> notify) { completed = notify; }
+
+    /**
+     * \brief Max time for the commands sent from now to complete
+     *
+     * \param ms Timeout (ms)
+     */
+    void setTimeout(unsigned int ms) { timeoutMs = ms; }
+
+    /**
+     * \brief Queue a command
+     *
+     * \param cmd The command string, without sequence ID and separators
+     * \return The future result
+     */
+    std::future<PONFReply> command(const std::string &cmd);
+
+    //! \brief Hold the commands queued from now to send them in a single frame
+    void beginBatch(void);
+
+    //! \brief Send the commands queued since beginBatch()
+    void endBatch(void);
+
+    // =========================================================
+    // Typed commands
+    // =========================================================
+
+    //! \brief Shoot (arm, fire and close) at the shutter speed
+    std::future<PONFReply> shot(PONFSpeed speed);
+
+    //! \brief Burst of MULTI_SHOOTING shots, 1/125 and faster speeds only
+    std::future<PONFReply> burst(PONFSpeed speed);
+
+    //! \brief Load the shutter and lock the bottom window
+    std::future<PONFReply> arm(void);
+
+    //! \brief Fire the armed shutter with the exposure (ms)
+    std::future<PONFReply> fire(unsigned int exposure);
+
+    //! \brief Execute a shutter motor cycle
+    std::future<PONFReply> cycle(void);
+
+    //! \brief Start a timelapse: interval (ms), frames (0 = endless), exposure (ms)
+    std::future<PONFReply> timelapse(unsigned long interval, unsigned long count, unsigned int exposure);
+
+    //! \brief Cancel the timelapse
+    std::future<PONFReply> timelapseStop(void);
+
+    //! \brief Arm the trigger input with the exposure (ms)
+    std::future<PONFReply> triggerArm(unsigned int exposure);
+
+    //! \brief Disarm the trigger input
+    std::future<PONFReply> triggerDisarm(void);
+
+    /**
+     * \brief Run a motor then stop it
+     *
+     * \param m The motor (2-6)
+     * \param dir MOTOR_DIRECTION_CW or MOTOR_DIRECTION_CCW
+     * \param ms Time (ms), up to MOTOR_MOVE_MAX_MS
+     */
+    std::future<PONFReply> motorMove(int m, int dir, unsigned int ms);
+
+    /**
+     * \brief Set the motor PWM
+     *
+     * \param m The motor (1-6)
+     * \param hz The frequency, 0 for no PWM
+     * \param dc The duty cycle
+     */
+    std::future<PONFReply> motorPWM(int m, unsigned int hz, uint8_t dc);
+
+    /**
+     * \brief Set the motor stop mode
+     *
+     * \param m The motor (1-6, 0 = all)
+     * \param mode MOTOR_STOP_COAST, MOTOR_STOP_BRAKE or MOTOR_STOP_TIMED
+     * \param ms Brake time (ms) of the timed brake
+     */
+    std::future<PONFReply> motorStopMode(int m, int mode, unsigned int ms);
+
+    //! \brief Apply a saved profile (1-3)
+    std::future<PONFReply> profileLoad(int profile);
+
+    /**
+     * \brief Change the serial speed of the controller and of the link.
+     * The commands queued meanwhile are held until the link has the new
+     * speed. Framed serial link only
+     *
+     * \param bps The speed (bps)
+     * \return false if the controller or the link refused the speed
+     */
+    bool setBaud(unsigned long bps);
+
+  private:
+    /**
+     * Command waiting to be sent or acknowledged
+     */
+    struct Pending {
+      long seq;                                         ///< Sequence ID
+      std::string cmd;                                  ///< Tagged command
+      std::string output;                               ///< Messages received while running
+      bool hold;                                        ///< Hold the next commands when sent
+      std::promise<PONFReply> reply;                    ///< Result
+      std::chrono::steady_clock::time_point deadline;   ///< Timeout
+    };
+
+    //! Link
+    PONFTransport &link;
+    //! Timeout (ms) of the new commands
+    unsigned int timeoutMs = PONF_TIMEOUT_MS;
+    //! Next sequence ID
+    long nextSeq = 1;
+    //! The threads are running
+    bool running = false;
+    //! Commands are held for a batch
+    bool batching = false;
+    //! Commands are held for a link change
+    bool holding = false;
+    //! Commands not sent yet
+    std::deque<Pending> queue;
+    //! Commands sent, by sequence ID
+    std::map<long, Pending> inFlight;
+    //! Sequence IDs of the last frame, in order
+    std::vector<long> frameSeqs;
+    //! Last frame sent, to send it again if the controller was busy
+    std::string lastFrame;
+    //! Command accepted last, the messages received belong to it
+    long currentSeq = -1;
+    //! Completion notification
+    std::function<void(void)> completed;
+    //! Protects all the state
+    std::mutex lock;
+    //! Signals the queue and the in flight changes
+    std::condition_variable changed;
+    //! Sender thread
+    std::thread sender;
+    //! Receiver thread
+    std::thread receiver;
+
+    //! \brief Build and send the frames
+    void sendLoop(void);
+
+    //! \brief Read and dispatch the acknowledges, expire the timeouts
+    void receiveLoop(void);
+
+    /**
+     * \brief Check if a frame can be sent. Called with the lock held
+     *
+     * \return true if there are commands queued and the window is open
+     */
+    bool canSend(void);
+
+    /**
+     * \brief Dispatch a status read from the link. Called with the lock held
+     *
+     * \param status A serial line or the I2C status register
+     */
+    void dispatch(const std::string &status);
+
+    /**
+     * \brief Satisfy an in flight command. Called with the lock held
+     *
+     * \param seq The sequence ID
+     * \param state The reply state
+     * \param micros The controller time
+     */
+    void complete(long seq, char state, unsigned long micros);
+
+    /**
+     * \brief Fail the commands whose deadline is expired. Called with the lock held
+     */
+    void expire(void);
+
+    /**
+     * \brief Queue a command
+     *
+     * \param cmd The command string
+     * \param hold Hold the commands queued after it when it is sent
+     * \return The future result
+     */
+    std::future<PONFReply> enqueue(const std::string &cmd, bool hold);
+
+    /**
+     * \brief Future already satisfied with an error
+     */
+    std::future<PONFReply> error(void);
+};
+
+#endif
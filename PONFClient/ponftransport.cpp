@@ -0,0 +1,408 @@
+/**
+ *  \file ponftransport.cpp
+ *  \brief This file defines functions from ponftransport.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "ponftransport.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <chrono>
+#include <algorithm>
+
+// ===============================================================
+// Serial link
+// ===============================================================
+
+PONFSerial::PONFSerial(const std::string &device, speed_t baud) :
+  device(device), speed(baud), fd(-1) {
+}
+
+PONFSerial::~PONFSerial() {
+  close();
+}
+
+bool PONFSerial::open(void) {
+  close();
+
+  fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if(fd < 0)
+    return false;
+
+  if(!setBaud(speed)) {
+    close();
+    return false;
+  }
+
+  tcflush(fd, TCIOFLUSH);
+  pending.clear();
+
+  return true;
+}
+
+void PONFSerial::close(void) {
+  if(fd >= 0)
+    ::close(fd);
+  fd = -1;
+}
+
+bool PONFSerial::setBaud(speed_t baud) {
+  struct termios tio;
+
+  if(tcgetattr(fd, &tio) != 0)
+    return false;
+
+  // Raw 8N1, the lines are split by the client
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, baud);
+  cfsetospeed(&tio, baud);
+  if(tcsetattr(fd, TCSADRAIN, &tio) != 0)
+    return false;
+
+  speed = baud;
+
+  return true;
+}
+
+bool PONFSerial::send(const std::string &frame) {
+  std::string line;
+  size_t done;
+  ssize_t n;
+
+  if(fd < 0)
+    return false;
+
+  line = frame + "\n";
+  for(done = 0; done < line.size(); done += n) {
+    n = ::write(fd, line.data() + done, line.size() - done);
+    if(n < 0)
+      return false;
+  }
+
+  return true;
+}
+
+bool PONFSerial::receive(std::string &status, int timeoutMs) {
+  struct pollfd pfd;
+  char buf[256];
+  size_t eol;
+  ssize_t n;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  if(fd < 0)
+    return false;
+
+  for(;;) {
+    eol = pending.find('\n');
+    if(eol != std::string::npos) {
+      status = pending.substr(0, eol);
+      pending.erase(0, eol + 1);
+      if(!status.empty() && (status[status.size() - 1] == '\r'))
+        status.erase(status.size() - 1);
+      return true;
+    }
+
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if(left <= 0)
+      return false;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if(poll(&pfd, 1, left) <= 0)
+      continue;
+
+    n = ::read(fd, buf, sizeof(buf));
+    if(n <= 0)
+      return false;
+    pending.append(buf, n);
+  }
+}
+
+// ===============================================================
+// Framed serial link
+// ===============================================================
+
+//! Termios constant of a speed, B0 if not supported
+static speed_t baudConstant(unsigned long bps) {
+  switch(bps) {
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    default: return B0;
+  }
+}
+
+//! Update the CRC-16/CCITT with a byte
+static uint16_t crcUpdate(uint16_t crc, uint8_t c) {
+  int j;
+
+  crc ^= (uint16_t)c << 8;
+  for(j = 0; j < 8; j++)
+    crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+
+  return crc;
+}
+
+PONFFramed::PONFFramed(const std::string &device, speed_t baud) :
+  PONFSerial(device, baud) {
+}
+
+bool PONFFramed::open(void) {
+  if(!PONFSerial::open())
+    return false;
+
+  std::lock_guard<std::mutex> l(tx);
+  waitSeq = -1;
+  ackCode = 0;
+
+  // The controller may have executed frames of a previous session
+  // with the same sequences
+  if(!transmit("", PONF_FRAME_SEND_MS)) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+bool PONFFramed::send(const std::string &frame) {
+  std::lock_guard<std::mutex> l(tx);
+
+  if( (fd < 0) || frame.empty() || (frame.size() > PONF_FRAME_PAYLOAD_MAX) )
+    return false;
+
+  return transmit(frame, PONF_FRAME_SEND_MS);
+}
+
+bool PONFFramed::setSpeed(unsigned long bps) {
+  std::lock_guard<std::mutex> l(tx);
+  speed_t old = speed;
+  speed_t baud = baudConstant(bps);
+
+  if( (fd < 0) || (baud == B0) || !setBaud(baud) )
+    return false;
+
+  if(transmit("", PONF_FRAME_CONFIRM_MS))
+    return true;
+
+  setBaud(old);
+  return false;
+}
+
+bool PONFFramed::transmit(const std::string &payload, int timeoutMs) {
+  std::string frame;
+  uint16_t crc;
+  size_t done;
+  ssize_t n;
+  int wait;
+  uint8_t result;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  crc = 0xFFFF;
+  frame += (char)PONF_FRAME_STX;
+  frame += (char)payload.size();
+  frame += (char)seq;
+  frame += payload;
+  for(done = 1; done < frame.size(); done++)
+    crc = crcUpdate(crc, frame[done]);
+  frame += (char)(crc >> 8);
+  frame += (char)(crc & 0xFF);
+
+  wait = PONF_FRAME_ACK_MS;
+  for(;;) {
+    {
+      std::lock_guard<std::mutex> l(rx);
+      waitSeq = seq;
+      waitResult = 0;
+    }
+
+    for(done = 0; done < frame.size(); done += n) {
+      n = ::write(fd, frame.data() + done, frame.size() - done);
+      if(n < 0)
+        return false;
+    }
+
+    // The controller reads the frames only between the commands, so the
+    // acknowledge can be late: wait longer every time
+    auto ackDeadline = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(wait));
+    for(;;) {
+      {
+        std::lock_guard<std::mutex> l(rx);
+        result = waitResult;
+      }
+      if(result != 0)
+        break;
+      int left = std::chrono::duration_cast<std::chrono::milliseconds>(ackDeadline - std::chrono::steady_clock::now()).count();
+      if(left <= 0)
+        break;
+      pump(left);
+    }
+
+    if(result == PONF_FRAME_ACK) {
+      seq++;
+      return true;
+    }
+    if(result == PONF_FRAME_NAK)
+      naks++;
+    else
+      wait = std::min(wait * 2, PONF_FRAME_ACK_MAX_MS);
+
+    if(std::chrono::steady_clock::now() >= deadline) {
+      // The next frame must not be taken for this one
+      seq++;
+      return false;
+    }
+    retransmits++;
+  }
+}
+
+bool PONFFramed::receive(std::string &status, int timeoutMs) {
+  size_t eol;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  if(fd < 0)
+    return false;
+
+  for(;;) {
+    {
+      std::lock_guard<std::mutex> l(rx);
+      eol = pending.find('\n');
+      if(eol != std::string::npos) {
+        status = pending.substr(0, eol);
+        pending.erase(0, eol + 1);
+        if(!status.empty() && (status[status.size() - 1] == '\r'))
+          status.erase(status.size() - 1);
+        return true;
+      }
+    }
+
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if(left <= 0)
+      return false;
+    pump(left);
+  }
+}
+
+void PONFFramed::pump(int timeoutMs) {
+  struct pollfd pfd;
+  uint8_t buf[256];
+  ssize_t n, j;
+
+  {
+    std::unique_lock<std::mutex> l(rx);
+    if(reading) {
+      rxDone.wait_for(l, std::chrono::milliseconds(timeoutMs));
+      return;
+    }
+    reading = true;
+  }
+
+  n = 0;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  if(poll(&pfd, 1, timeoutMs) > 0)
+    n = ::read(fd, buf, sizeof(buf));
+
+  {
+    std::lock_guard<std::mutex> l(rx);
+    // The acknowledges are two bytes anywhere in the console messages
+    for(j = 0; j < n; j++) {
+      if(ackCode != 0) {
+        if(buf[j] == waitSeq)
+          waitResult = ackCode;
+        ackCode = 0;
+      }
+      else if( (buf[j] == PONF_FRAME_ACK) || (buf[j] == PONF_FRAME_NAK) )
+        ackCode = buf[j];
+      else
+        pending += (char)buf[j];
+    }
+    reading = false;
+  }
+  rxDone.notify_all();
+
+  // Closed or error, don't spin
+  if(n < 0)
+    usleep(timeoutMs * 1000);
+}
+
+// ===============================================================
+// I2C link
+// ===============================================================
+
+PONFI2C::PONFI2C(const std::string &device, int address) :
+  device(device), address(address), fd(-1) {
+}
+
+PONFI2C::~PONFI2C() {
+  close();
+}
+
+bool PONFI2C::open(void) {
+  close();
+
+  fd = ::open(device.c_str(), O_RDWR | O_CLOEXEC);
+  if(fd < 0)
+    return false;
+
+  if(ioctl(fd, I2C_SLAVE, address) < 0) {
+    close();
+    return false;
+  }
+
+  lastStatus.clear();
+
+  return true;
+}
+
+void PONFI2C::close(void) {
+  if(fd >= 0)
+    ::close(fd);
+  fd = -1;
+}
+
+bool PONFI2C::send(const std::string &frame) {
+  if( (fd < 0) || (frame.size() > PONF_I2C_FRAME_MAX) )
+    return false;
+
+  // The status of the previous frame can be read again
+  lastStatus.clear();
+
+  return ::write(fd, frame.data(), frame.size()) == (ssize_t)frame.size();
+}
+
+bool PONFI2C::receive(std::string &status, int timeoutMs) {
+  char buf[PONF_I2C_STATUS_MAX];
+  ssize_t n, j;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  if(fd < 0)
+    return false;
+
+  do {
+    n = ::read(fd, buf, sizeof(buf));
+    if(n > 0) {
+      // The status is followed by the padding of the slave
+      for(j = 0; (j < n) && (buf[j] >= ' ') && (buf[j] <= '~'); j++)
+        ;
+      status.assign(buf, j);
+      if(!status.empty() && (status != lastStatus)) {
+        lastStatus = status;
+        return true;
+      }
+    }
+    usleep(PONF_I2C_POLL_US);
+  } while(std::chrono::steady_clock::now() < deadline);
+
+  return false;
+}
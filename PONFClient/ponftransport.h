@@ -0,0 +1,238 @@
+/**
+ *  \file ponftransport.h
+ *  \brief Links between the CM3 master and the shutter controller
+ *
+ *  The client sends frames of one or more commands separated by CMD_SEP
+ *  and reads back the acknowledges of the tagged commands:
+ *  - serial (tty or pty): the frame is a line, every acknowledge is a
+ *    line "<state> <seq> <micros>" mixed with the other console messages;
+ *  - framed serial: as the serial, but every frame is sent with length,
+ *    sequence and CRC-16 and is sent again until the controller
+ *    acknowledges it (controller built with _FRAMED, see framelink.h);
+ *  - Linux i2c-dev: the frame is written to the slave, then the status
+ *    register is polled until it shows the acknowledge of the last command
+ *    followed by the status of all the frame commands. The controller
+ *    discards the frames received while a frame is running, so only one
+ *    frame at a time can be in flight.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _PONFTRANSPORT
+#define _PONFTRANSPORT
+
+#include <stdint.h>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <termios.h>
+
+#define PONF_SERIAL_BAUD B38400     ///< Default serial speed of the controller
+#define PONF_SERIAL_FRAME_MAX 128   ///< Max length of a serial frame (CMD_LINE_MAX)
+#define PONF_SERIAL_WINDOW 8        ///< Max commands in flight on the serial
+
+// Framed serial, as defined by the controller framelink.h
+#define PONF_FRAME_STX 0x02           ///< Start of frame
+#define PONF_FRAME_ACK 0x06           ///< Frame received, followed by the sequence
+#define PONF_FRAME_NAK 0x15           ///< Frame corrupted, followed by the sequence
+#define PONF_FRAME_PAYLOAD_MAX 56     ///< Max payload length (FRAME_PAYLOAD_MAX)
+#define PONF_FRAME_ACK_MS 100         ///< First wait (ms) for the acknowledge, doubled on every retry
+#define PONF_FRAME_ACK_MAX_MS 3200    ///< Max wait (ms) for the acknowledge before sending again
+#define PONF_FRAME_SEND_MS 15000      ///< Max time (ms) to deliver a frame, covers the longest command
+#define PONF_FRAME_CONFIRM_MS 1000    ///< Max wait (ms) for the acknowledge at a new speed
+
+#define PONF_I2C_ADDRESS 0x04       ///< Default controller slave address
+#define PONF_I2C_FRAME_MAX 32       ///< Max length of an I2C frame (Wire buffer size)
+#define PONF_I2C_STATUS_MAX 32      ///< Bytes read from the status register
+#define PONF_I2C_POLL_US 500        ///< Delay (us) between two status register reads
+
+/**
+ * \brief Link to the controller
+ */
+class PONFTransport {
+  public:
+    virtual ~PONFTransport() {}
+
+    /**
+     * \brief Open the link
+     *
+     * \return false if the device can't be opened or configured
+     */
+    virtual bool open(void) = 0;
+
+    //! \brief Close the link
+    virtual void close(void) = 0;
+
+    /**
+     * \brief Send a frame
+     *
+     * \param frame The commands, without line terminator
+     * \return false on write error
+     */
+    virtual bool send(const std::string &frame) = 0;
+
+    /**
+     * \brief Read the next status: a serial line or the I2C status register
+     *
+     * \param status The status read
+     * \param timeoutMs Max wait (ms)
+     * \return false if nothing has been read within the timeout
+     */
+    virtual bool receive(std::string &status, int timeoutMs) = 0;
+
+    //! \brief Max length of a frame
+    virtual size_t maxFrame(void) const = 0;
+
+    //! \brief Max number of commands in flight, 0 for one frame at a time
+    virtual unsigned int window(void) const = 0;
+
+    /**
+     * \brief Switch to the speed just accepted by the controller
+     *
+     * \param bps The speed (bps)
+     * \return false if the link has no speed or the controller does not answer
+     */
+    virtual bool setSpeed(unsigned long) { return false; }
+};
+
+/**
+ * \brief Serial link, on a tty or on a pty
+ */
+class PONFSerial : public PONFTransport {
+  public:
+
+    /**
+     * \param device The device path, e.g. /dev/ttyAMA0
+     * \param baud The termios speed
+     */
+    PONFSerial(const std::string &device, speed_t baud = PONF_SERIAL_BAUD);
+    ~PONFSerial();
+
+    bool open(void);
+    void close(void);
+    bool send(const std::string &frame);
+    bool receive(std::string &status, int timeoutMs);
+    size_t maxFrame(void) const { return PONF_SERIAL_FRAME_MAX; }
+    unsigned int window(void) const { return PONF_SERIAL_WINDOW; }
+
+    /**
+     * \brief Change the speed of the open link
+     *
+     * \param baud The termios speed
+     * \return false if the speed can't be set
+     */
+    bool setBaud(speed_t baud);
+
+  protected:
+    //! Device path
+    std::string device;
+    //! Current speed
+    speed_t speed;
+    //! File descriptor, -1 if closed
+    int fd;
+    //! Characters received after the last complete line
+    std::string pending;
+};
+
+/**
+ * \brief Serial link with CRC frames, acknowledge and retransmit
+ */
+class PONFFramed : public PONFSerial {
+  public:
+
+    //! Frames sent again after a NAK or without acknowledge
+    unsigned long retransmits = 0;
+    //! NAK received
+    unsigned long naks = 0;
+
+    /**
+     * \param device The device path, e.g. /dev/ttyAMA0
+     * \param baud The termios speed, the controller always boots at PONF_SERIAL_BAUD
+     */
+    PONFFramed(const std::string &device, speed_t baud = PONF_SERIAL_BAUD);
+
+    //! \brief Open the link and reset the controller sequence
+    bool open(void);
+
+    /**
+     * \brief Send a frame and wait for its acknowledge, sending it again
+     * on NAK or timeout up to PONF_FRAME_SEND_MS
+     */
+    bool send(const std::string &frame);
+    bool receive(std::string &status, int timeoutMs);
+    size_t maxFrame(void) const { return PONF_FRAME_PAYLOAD_MAX; }
+
+    /**
+     * \brief Switch the speed and confirm it with an empty frame. If the
+     * controller does not answer the previous speed is restored, as the
+     * controller does after FRAME_BAUD_CONFIRM_MS
+     */
+    bool setSpeed(unsigned long bps);
+
+  private:
+    //! Sequence of the next frame
+    uint8_t seq = 0;
+    //! Sequence of the frame waiting for the acknowledge
+    int waitSeq = -1;
+    //! Acknowledge received for waitSeq: PONF_FRAME_ACK, PONF_FRAME_NAK or 0
+    uint8_t waitResult = 0;
+    //! Acknowledge code received, the next byte is the sequence
+    uint8_t ackCode = 0;
+    //! A thread is reading the device
+    bool reading = false;
+    //! Serialises the frames
+    std::mutex tx;
+    //! Protects the received data
+    std::mutex rx;
+    //! Signals the data read
+    std::condition_variable rxDone;
+
+    /**
+     * \brief Read the device once, or wait for the thread reading it
+     *
+     * \param timeoutMs Max wait (ms)
+     */
+    void pump(int timeoutMs);
+
+    /**
+     * \brief Send a payload, called with tx held
+     *
+     * \param payload The frame payload, empty to reset the sequence
+     * \param timeoutMs Max time (ms) to deliver the frame
+     * \return false if the frame has not been acknowledged
+     */
+    bool transmit(const std::string &payload, int timeoutMs);
+};
+
+/**
+ * \brief I2C link through the Linux i2c-dev interface
+ */
+class PONFI2C : public PONFTransport {
+  public:
+
+    /**
+     * \param device The bus device, e.g. /dev/i2c-1
+     * \param address The controller slave address
+     */
+    PONFI2C(const std::string &device, int address = PONF_I2C_ADDRESS);
+    ~PONFI2C();
+
+    bool open(void);
+    void close(void);
+    bool send(const std::string &frame);
+    bool receive(std::string &status, int timeoutMs);
+    size_t maxFrame(void) const { return PONF_I2C_FRAME_MAX; }
+    unsigned int window(void) const { return 0; }
+
+  private:
+    //! Device path
+    std::string device;
+    //! Slave address
+    int address;
+    //! File descriptor, -1 if closed
+    int fd;
+    //! Last status register read, the same status is returned only once per frame
+    std::string lastStatus;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Shutter controller simulator on a pseudo terminal, for the client and
+daemon tests.
+
+The device path is printed on the first line of the output. The
+commands are executed like the controller does: a line can hold several
+commands separated by ';', every sequence tagged command is acknowledged
+with "A <seq> <micros>", one message line and "C <seq> <micros>", or
+"F <seq> <micros>" for the commands starting with "bad". The commands
+starting with "hang" are accepted and never completed, the ones starting
+with "slow" take 200 ms.
+
+With -f the commands are received in CRC frames like the controller
+framed link (framelink.h). The incoming bytes can be corrupted and the
+acknowledges dropped with the probability given by -c.
+
+The commands executed are written to the log, one per line.
+
+usage: ponfsim.py [-l <log>] [-d <ms>] [-f [-c <probability>] [-s <seed>]]
+
+Licensed under GNU LGPL 3.0
+"""
+
+import argparse
+import os
+import pty
+import random
+import select
+import sys
+import time
+import tty
+
+CMD_SEP = ';'
+CMD_SEQ_PREFIX = '#'
+CMD_SEQ_END = ':'
+SLOW_MS = 200
+
+FRAME_STX = 0x02
+FRAME_ACK = 0x06
+FRAME_NAK = 0x15
+FRAME_PAYLOAD_MAX = 56
+FRAME_BYTE_MS = 50
+
+
+def micros():
+    return int(time.monotonic() * 1e6) % (1 << 32)
+
+
+class Controller:
+    def __init__(self, fd, log, delay):
+        self.fd = fd
+        self.log = log
+        self.delay = delay / 1000.0
+
+    def write(self, line):
+        os.write(self.fd, (line + "\r\n").encode())
+
+    def execute(self, line):
+        for cmd in line.split(CMD_SEP):
+            cmd = cmd.strip()
+            if not cmd.startswith(CMD_SEQ_PREFIX) or CMD_SEQ_END not in cmd:
+                continue
+            seq, cmd = cmd[1:].split(CMD_SEQ_END, 1)
+            self.log.write(cmd + "\n")
+            self.log.flush()
+
+            self.write("A %s %d" % (seq, micros()))
+            if cmd.startswith("hang"):
+                continue
+            time.sleep(SLOW_MS / 1000.0 if cmd.startswith("slow") else self.delay)
+            self.write("run " + cmd)
+            self.write("%s %s %d" % ('F' if cmd.startswith("bad") else 'C', seq, micros()))
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for c in data:
+        crc ^= c << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class FrameLink:
+    """Receiver of the framed link, see FrameLink::receive()"""
+
+    def __init__(self, fd, noise):
+        self.fd = fd
+        self.noise = noise
+        self.frame = bytearray()
+        self.last_seq = -1
+        self.last_byte = 0
+
+    def reply(self, code, seq):
+        if random.random() < self.noise:
+            return
+        os.write(self.fd, bytes([code, seq]))
+
+    def expire(self):
+        if self.frame and (time.monotonic() - self.last_byte) * 1000 > FRAME_BYTE_MS:
+            if len(self.frame) >= 3:
+                self.reply(FRAME_NAK, self.frame[2])
+            self.frame = bytearray()
+
+    def receive(self, data):
+        """Payloads of the new frames received"""
+        payloads = []
+        data = bytearray(data)
+        if data and random.random() < self.noise:
+            data[random.randrange(len(data))] ^= 0x10
+
+        for c in data:
+            self.last_byte = time.monotonic()
+            if not self.frame:
+                if c == FRAME_STX:
+                    self.frame.append(c)
+                continue
+            self.frame.append(c)
+            if len(self.frame) == 2 and c > FRAME_PAYLOAD_MAX:
+                self.frame = bytearray()
+                continue
+            if len(self.frame) < 2 or len(self.frame) < self.frame[1] + 5:
+                continue
+
+            frame, self.frame = self.frame, bytearray()
+            length, seq = frame[1], frame[2]
+            if crc16(frame[1:3 + length]) != (frame[3 + length] << 8 | frame[4 + length]):
+                self.reply(FRAME_NAK, seq)
+                continue
+            self.reply(FRAME_ACK, seq)
+            if length == 0:
+                self.last_seq = -1
+            elif seq != self.last_seq:
+                self.last_seq = seq
+                payloads.append(bytes(frame[3:3 + length]))
+
+        return payloads
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-l", dest="log", default=os.devnull, help="log of the commands executed")
+    parser.add_argument("-d", dest="delay", type=int, default=5, help="time (ms) of a command")
+    parser.add_argument("-f", dest="framed", action="store_true", help="framed link")
+    parser.add_argument("-c", dest="noise", type=float, default=0, help="probability of a corrupted read or a lost acknowledge")
+    parser.add_argument("-s", dest="seed", type=int, default=1, help="seed of the errors")
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    print(os.ttyname(slave), flush=True)
+
+    ctrl = Controller(master, open(args.log, "w"), args.delay)
+    link = FrameLink(master, args.noise) if args.framed else None
+    buf = b''
+    while True:
+        if link is not None:
+            # The partial frames expire without new bytes too
+            if not select.select([master], [], [], FRAME_BYTE_MS / 1000.0)[0]:
+                link.expire()
+                continue
+        try:
+            data = os.read(master, 1024)
+        except OSError:
+            break
+        if not data:
+            break
+        if link is not None:
+            for payload in link.receive(data):
+                ctrl.execute(payload.decode(errors="replace"))
+            continue
+        buf += data
+        while b'\n' in buf:
+            line, buf = buf.split(b'\n', 1)
+            ctrl.execute(line.decode(errors="replace"))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,195 @@
+/**
+ *  \file testclient.cpp
+ *  \brief Client tests on the controller simulator
+ *
+ *  \code
+ *  testclient [-f [-n]] <tty>
+ *  \endcode
+ *
+ *  The tty is the pseudo terminal of ponfsim.py, see the Makefile. With -f
+ *  the framed link is used, with -n the simulator corrupts the frames and
+ *  drops the acknowledges.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../ponfclient.h"
+
+//! Checks failed
+static int failures = 0;
+
+#define CHECK(c) do { \
+  if(!(c)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #c); \
+    failures++; \
+  } \
+} while(0)
+
+//! Max wait (ms) of a command in the tests
+#define TEST_TIMEOUT_MS 2000
+
+//! A command completes with its messages
+static void testCommand(PONFClient &client, PONFTransport &link) {
+  PONFReply r;
+  std::string fit;
+
+  r = client.command("one").get();
+  CHECK(r.ok());
+  CHECK(r.output == "run one\n");
+
+  r = client.command("bad").get();
+  CHECK(r.state == CMD_ACK_FAILED);
+
+  // Rejected before being sent
+  CHECK(client.command("").get().state == PONF_STATE_ERROR);
+  CHECK(client.command("a;b").get().state == PONF_STATE_ERROR);
+  CHECK(client.command(std::string(link.maxFrame(), 'x')).get().state == PONF_STATE_ERROR);
+
+  // The longest command with the sequence ID (3 digits) and the separator
+  fit = std::string(link.maxFrame() - 6, 'x');
+  r = client.command(fit).get();
+  CHECK(r.ok());
+  CHECK(r.output == "run " + fit + "\n");
+}
+
+//! The commands are sent before the previous ones complete, up to the window
+static void testPipeline(PONFClient &client, bool framed) {
+  std::vector<std::future<PONFReply>> r;
+  unsigned long commands = client.commands;
+  int j;
+
+  // The controller is busy for 200 ms on the first command
+  r.push_back(client.command("slow"));
+  for(j = 1; j < PONF_SERIAL_WINDOW + 4; j++)
+    r.push_back(client.command("pipe" + std::to_string(j)));
+  CHECK(r[0].wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+  // The frame acknowledges are not sent while the controller executes a
+  // command, the frames sent depend on how the commands were packed
+  if(framed)
+    CHECK((client.commands - commands > 1) && (client.commands - commands <= PONF_SERIAL_WINDOW));
+  else
+    CHECK(client.commands - commands == PONF_SERIAL_WINDOW);
+
+  for(j = 0; j < (int)r.size(); j++) {
+    PONFReply p = r[j].get();
+    CHECK(p.ok());
+    CHECK(p.output == ((j == 0) ? std::string("run slow\n") : "run pipe" + std::to_string(j) + "\n"));
+  }
+  CHECK(client.commands - commands == r.size());
+}
+
+//! The commands of a batch are sent in a single frame
+static void testBatch(PONFClient &client) {
+  std::vector<std::future<PONFReply>> r;
+  unsigned long frames = client.frames;
+  int j;
+
+  client.beginBatch();
+  for(j = 0; j < 4; j++)
+    r.push_back(client.command("batch" + std::to_string(j)));
+  // Nothing is sent before the end of the batch
+  CHECK(r[0].wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+  client.endBatch();
+
+  for(auto &f : r)
+    CHECK(f.get().ok());
+  CHECK(client.frames - frames == 1);
+}
+
+//! A command without acknowledge expires, the next ones are not affected
+static void testTimeout(PONFClient &client) {
+  std::future<PONFReply> hang, slow;
+  unsigned long timeouts = client.timeouts;
+
+  client.setTimeout(300);
+  hang = client.command("hang");
+  CHECK(hang.get().state == PONF_STATE_TIMEOUT);
+  CHECK(client.timeouts - timeouts == 1);
+
+  client.setTimeout(TEST_TIMEOUT_MS);
+  slow = client.command("slow");
+  CHECK(slow.get().ok());
+  CHECK(client.command("after").get().ok());
+}
+
+//! The speed is changed and confirmed by the controller
+static void testSpeed(PONFClient &client) {
+  CHECK(client.setBaud(115200));
+  CHECK(!client.setBaud(1234));
+  CHECK(client.command("one").get().ok());
+}
+
+//! Every command is executed once when the frames or the acknowledges are lost
+static void testNoise(PONFClient &client, PONFFramed &link) {
+  std::vector<std::future<PONFReply>> r;
+  int j;
+
+  for(j = 0; j < 100; j++)
+    r.push_back(client.command("noise" + std::to_string(j)));
+  for(j = 0; j < (int)r.size(); j++) {
+    PONFReply p = r[j].get();
+    CHECK(p.ok());
+    CHECK(p.output == "run noise" + std::to_string(j) + "\n");
+  }
+
+  CHECK(link.retransmits > 0);
+}
+
+int main(int argc, char* argv[]) {
+  bool framed = false, noise = false;
+  int opt;
+
+  while((opt = getopt(argc, argv, "fn")) != -1) {
+    switch(opt) {
+      case 'f':
+        framed = true;
+      break;
+      case 'n':
+        noise = true;
+      break;
+      default:
+        optind = argc;
+    }
+  }
+  if( (optind != argc - 1) || (noise && !framed) ) {
+    fprintf(stderr, "usage: %s [-f [-n]] <tty>\n", argv[0]);
+    return 2;
+  }
+
+  PONFSerial serial(argv[optind]);
+  PONFFramed frames(argv[optind]);
+  PONFTransport &link = framed ? (PONFTransport&)frames : (PONFTransport&)serial;
+  PONFClient client(link);
+
+  client.setTimeout(noise ? PONF_FRAME_SEND_MS : TEST_TIMEOUT_MS);
+  if(!client.begin()) {
+    fprintf(stderr, "%s: can't open %s\n", argv[0], argv[optind]);
+    return 2;
+  }
+
+  if(noise)
+    testNoise(client, frames);
+  else {
+    testCommand(client, link);
+    testPipeline(client, framed);
+    testBatch(client);
+    testTimeout(client);
+    if(framed)
+      testSpeed(client);
+  }
+
+  client.end();
+  // The pending commands fail when the client is stopped
+  CHECK(client.command("closed").get().state == PONF_STATE_ERROR);
+
+  printf("frames %lu, commands %lu, timeouts %lu: %s\n", client.frames, client.commands,
+    client.timeouts, (failures == 0) ? "passed" : "FAILED");
+
+  return (failures == 0) ? 0 : 1;
+}
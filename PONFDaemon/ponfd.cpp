@@ -0,0 +1,113 @@
+/**
+ *  \file ponfd.cpp
+ *  \brief CM3 daemon of the shutter controller
+ *
+ *  \code
+ *  ponfd -s /dev/ttyAMA0 [-l /run/ponfd.sock]
+ *  ponfd -f /dev/ttyAMA0 [-b 460800] [-l /run/ponfd.sock]
+ *  ponfd -i /dev/i2c-1 [-a 4] [-l /run/ponfd.sock]
+ *  \endcode
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "ponfdaemon.h"
+
+//! The daemon, stopped by the signals
+static PONFDaemon* daemonRunning = NULL;
+
+//! Stop the daemon on SIGINT and SIGTERM
+static void terminate(int) {
+  if(daemonRunning != NULL)
+    daemonRunning->stop();
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s -s <tty> | -f <tty> [-b <speed>] | -i <i2c device> [-a <address>] [-l <socket>]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+  std::unique_ptr<PONFTransport> link;
+  std::string socketPath = PONFD_SOCKET;
+  std::string serial, i2c;
+  bool framed = false;
+  unsigned long baud = 0;
+  int address = PONF_I2C_ADDRESS;
+  int opt;
+
+  while((opt = getopt(argc, argv, "s:f:b:i:a:l:")) != -1) {
+    switch(opt) {
+      case 's':
+        serial = optarg;
+      break;
+      case 'f':
+        serial = optarg;
+        framed = true;
+      break;
+      case 'b':
+        baud = strtoul(optarg, NULL, 10);
+      break;
+      case 'i':
+        i2c = optarg;
+      break;
+      case 'a':
+        address = strtol(optarg, NULL, 0);
+      break;
+      case 'l':
+        socketPath = optarg;
+      break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if( (serial.empty() == i2c.empty()) || ((baud != 0) && !framed) ) {
+    usage(argv[0]);
+    return 1;
+  }
+  if(framed)
+    link.reset(new PONFFramed(serial));
+  else if(!serial.empty())
+    link.reset(new PONFSerial(serial));
+  else
+    link.reset(new PONFI2C(i2c, address));
+
+  PONFClient client(*link);
+  PONFDaemon daemon(client);
+
+  if(!client.begin()) {
+    fprintf(stderr, "%s: can't open the controller link\n", argv[0]);
+    return 1;
+  }
+  if( (baud != 0) && !client.setBaud(baud) )
+    fprintf(stderr, "%s: can't change the speed to %lu\n", argv[0], baud);
+  if(!daemon.begin(socketPath)) {
+    fprintf(stderr, "%s: can't create %s\n", argv[0], socketPath.c_str());
+    return 1;
+  }
+
+  daemonRunning = &daemon;
+  signal(SIGINT, terminate);
+  signal(SIGTERM, terminate);
+  signal(SIGPIPE, SIG_IGN);
+
+  daemon.run();
+  daemonRunning = NULL;
+
+  fprintf(stderr, "requests %lu, sent %lu, coalesced %lu, cached %lu\n",
+    daemon.requests, daemon.submitted, daemon.coalesced, daemon.cached);
+  fprintf(stderr, "frames %lu, commands %lu, timeouts %lu, resent %lu\n",
+    client.frames, client.commands, client.timeouts, client.resent);
+
+  client.end();
+
+  return 0;
+}
@@ -0,0 +1,535 @@
+/**
+ *  \file ponfdaemon.cpp
+ *  \brief This file defines functions from ponfdaemon.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "ponfdaemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <string.h>
+#include <algorithm>
+
+#define PONFD_OUT_MAX 256   ///< Max replies queued to a process before it is disconnected
+
+/**
+ * Configuration command
+ */
+struct configDef {
+  const char* name;   ///< Command name
+  bool perUnit;       ///< The first parameter selects the motor or channel (0 = all)
+};
+
+//! Configuration writes that can be coalesced
+static const configDef configTable[] = {
+  { MOTOR_STAGGER, false },
+  { MOTOR_STOP_MODE, true },
+  { MOTOR_PWM, true },
+  { PWM_FREQ, true },
+  { MANUAL_DC, true },
+  { SH_RELEASE, false },
+  { IDLE_TIMEOUT, false },
+  { LOG_SET_LEVEL, false }
+};
+
+//! Status reads
+static const char* const statusTable[] = {
+  SHOW_CONF, TL_INFO, INFO_DC, PROF_INFO, IDLE_INFO, TH_INFO, SCH_INFO,
+  CAP_INFO, STATS_SHOW, LOG_SHOW_INFO, SH_CYCLE_INFO, MC_LIST, SER_INFO
+};
+
+//! Shooting commands, sent first
+static const char* const shotTable[] = {
+  SHOT_8S, SHOT_4S, SHOT_2S, SHOT_1S, SHOT_2, SHOT_4, SHOT_8, SHOT_15,
+  SHOT_30, SHOT_60, SHOT_125, SHOT_250, SHOT_400, SHOT_1000,
+  SHOT_MULTI125, SHOT_MULTI250, SHOT_MULTI400, SHOT_MULTI1000,
+  SH_ARM, SH_MOTOR_CYCLE, TRG_DISARM, TRG_FIRE
+};
+
+//! Shooting commands followed by the exposure
+static const char* const exposureTable[] = {
+  SH_FIRE, TRG_ARM
+};
+
+#define tableSize(t) (sizeof(t) / sizeof(t[0]))
+
+//! Check if a command starts with a name
+static bool startsWith(const std::string &cmd, const char* name) {
+  return cmd.compare(0, strlen(name), name) == 0;
+}
+
+PONFDaemon::PONFDaemon(PONFClient &client) : client(client) {
+  // The client receiver wakes up the event loop
+  client.onComplete([this] {
+    char c = 0;
+    if(write(wakeFd[1], &c, 1) < 0)
+      return;   // Already pending
+  });
+}
+
+PONFDaemon::~PONFDaemon() {
+  for(auto &c : clients)
+    close(c.second.fd);
+  if(listenFd >= 0) {
+    close(listenFd);
+    unlink(path.c_str());
+  }
+  if(wakeFd[0] >= 0) {
+    close(wakeFd[0]);
+    close(wakeFd[1]);
+  }
+}
+
+bool PONFDaemon::begin(const std::string &socketPath) {
+  struct sockaddr_un addr;
+
+  path = socketPath;
+  if(path.size() >= sizeof(addr.sun_path))
+    return false;
+
+  if(pipe2(wakeFd, O_NONBLOCK | O_CLOEXEC) != 0)
+    return false;
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(listenFd < 0)
+    return false;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  if( (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+      (listen(listenFd, PONFD_MAX_CLIENTS) != 0) )
+    return false;
+  chmod(path.c_str(), 0660);
+
+  return true;
+}
+
+void PONFDaemon::stop(void) {
+  char c = 0;
+
+  running = false;
+  if(write(wakeFd[1], &c, 1) < 0)
+    return;
+}
+
+// ===============================================================
+// Event loop
+// ===============================================================
+
+void PONFDaemon::run(void) {
+  std::vector<struct pollfd> fds;
+  std::vector<unsigned long> ids;
+  struct pollfd pfd;
+  char buf[64];
+  size_t j;
+
+  running = true;
+  while(running) {
+    fds.clear();
+    ids.clear();
+
+    pfd.fd = wakeFd[0];
+    pfd.events = POLLIN;
+    fds.push_back(pfd);
+    pfd.fd = listenFd;
+    pfd.events = (clients.size() < PONFD_MAX_CLIENTS) ? POLLIN : 0;
+    fds.push_back(pfd);
+    for(auto &c : clients) {
+      pfd.fd = c.second.fd;
+      pfd.events = POLLIN | (c.second.out.empty() ? 0 : POLLOUT);
+      fds.push_back(pfd);
+      ids.push_back(c.first);
+    }
+
+    if( (poll(fds.data(), fds.size(), -1) < 0) && (errno != EINTR) )
+      break;
+
+    if(fds[0].revents & POLLIN) {
+      while(read(wakeFd[0], buf, sizeof(buf)) > 0)
+        ;
+    }
+    if(fds[1].revents & POLLIN)
+      accept();
+
+    for(j = 0; j < ids.size(); j++) {
+      if( (fds[j + 2].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(ids[j]) ) {
+        close(clients[ids[j]].fd);
+        clients.erase(ids[j]);
+      }
+    }
+
+    // The errors are satisfied immediately, so submit until nothing completes
+    do
+      submit();
+    while(collect());
+
+    for(j = 0; j < ids.size(); j++) {
+      auto c = clients.find(ids[j]);
+      if( (c != clients.end()) && !c->second.out.empty() && !transmit(ids[j]) ) {
+        close(c->second.fd);
+        clients.erase(c);
+      }
+    }
+  }
+}
+
+void PONFDaemon::accept(void) {
+  int fd;
+
+  fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if(fd < 0)
+    return;
+
+  clients[nextClient++] = Client{ fd, "", std::deque<Buffer>(), 0 };
+}
+
+bool PONFDaemon::receive(unsigned long id) {
+  Client &c = clients[id];
+  char buf[PONFD_LINE_MAX];
+  ssize_t n;
+  size_t eol;
+
+  n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+  if(n == 0)
+    return false;
+  if(n < 0)
+    return (errno == EAGAIN) || (errno == EINTR);
+
+  c.in.append(buf, n);
+  while((eol = c.in.find('\n')) != std::string::npos) {
+    std::string line = c.in.substr(0, eol);
+    c.in.erase(0, eol + 1);
+    request(id, line);
+  }
+
+  return c.in.size() <= PONFD_LINE_MAX;
+}
+
+bool PONFDaemon::transmit(unsigned long id) {
+  Client &c = clients[id];
+  ssize_t n;
+
+  while(!c.out.empty()) {
+    const std::string &b = *c.out.front();
+    n = send(c.fd, b.data() + c.sent, b.size() - c.sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(n < 0)
+      return (errno == EAGAIN) || (errno == EINTR);
+    c.sent += n;
+    if(c.sent == b.size()) {
+      c.out.pop_front();
+      c.sent = 0;
+    }
+  }
+
+  return true;
+}
+
+// ===============================================================
+// Requests
+// ===============================================================
+
+void PONFDaemon::request(unsigned long id, const std::string &line) {
+  size_t sp1, sp2;
+  std::string tag, cmd, key;
+  int prio;
+  uint8_t kind;
+  Request r;
+  Request* q;
+
+  requests++;
+
+  // <tag> <priority> <command>
+  sp1 = line.find(' ');
+  sp2 = (sp1 == std::string::npos) ? sp1 : line.find(' ', sp1 + 1);
+  if( (sp1 == 0) || (sp2 == std::string::npos) || (sp2 != sp1 + 2) ) {
+    reply(std::vector<Waiter>{ Waiter{ id, (sp1 == std::string::npos) ? line : line.substr(0, sp1) } },
+      PONFReply{ PONFD_STATE_BAD, -1, 0, "" }, Buffer());
+    return;
+  }
+  tag = line.substr(0, sp1);
+  cmd = line.substr(sp2 + 1);
+  while(!cmd.empty() && ((cmd[cmd.size() - 1] == '\r') || (cmd[cmd.size() - 1] == ' ')))
+    cmd.erase(cmd.size() - 1);
+
+  // The link speed is set by the daemon only, see PONFClient::setBaud()
+  if(startsWith(cmd, SER_BAUD)) {
+    reply(std::vector<Waiter>{ Waiter{ id, tag } }, PONFReply{ PONFD_STATE_BAD, -1, 0, "" }, Buffer());
+    return;
+  }
+
+  // While a macro is recorded the controller stores the commands instead
+  // of executing them: all of them are recorded, in the order received
+  if(startsWith(cmd, MC_REC))
+    recording = true;
+  if(recording) {
+    if(cmd == MC_END)
+      recording = false;
+    kind = PONFD_KIND_ACTION;
+    prio = PONFD_PRIO_NORMAL;
+  }
+  else
+    kind = classify(cmd, key, prio);
+  if(!recording && (line[sp1 + 1] != PONFD_PRIO_DEFAULT)) {
+    prio = line[sp1 + 1] - '0';
+    if( (prio < PONFD_PRIO_HIGH) || (prio > PONFD_PRIO_LOW) ) {
+      reply(std::vector<Waiter>{ Waiter{ id, tag } }, PONFReply{ PONFD_STATE_BAD, -1, 0, "" }, Buffer());
+      return;
+    }
+  }
+
+  // The status reads and the writes received before a command, or the
+  // status reads received before a write, are not merged with the later
+  // requests
+  if(kind != PONFD_KIND_STATUS)
+    barrier(kind);
+
+  // The new value replaces the queued write of the same setting. A write
+  // is always sent: the controller settings can change without the
+  // daemon knowing, after a reset or a watchdog recovery. The request of
+  // a process with queued requests is never merged, it could be sent
+  // before them
+  if(kind == PONFD_KIND_CONFIG) {
+    q = queued(id) ? NULL : find(kind, key, true);
+    if(q != NULL) {
+      q->cmd = cmd;
+      q->waiters.push_back(Waiter{ id, tag });
+      coalesced++;
+      return;
+    }
+  }
+  else if(kind == PONFD_KIND_STATUS) {
+    // The cached status is not valid after the commands queued before
+    auto s = statusCache.find(key);
+    if( (s != statusCache.end()) && !changing() &&
+        (std::chrono::steady_clock::now() - s->second.time < std::chrono::milliseconds(PONFD_STATUS_TTL_MS)) ) {
+      reply(std::vector<Waiter>{ Waiter{ id, tag } }, s->second.reply, s->second.output);
+      cached++;
+      return;
+    }
+    // Shared with the same read queued or running
+    q = queued(id) ? NULL : find(kind, key, false);
+    if(q != NULL) {
+      q->waiters.push_back(Waiter{ id, tag });
+      cached++;
+      return;
+    }
+  }
+
+  r.owner = id;
+  r.order = nextOrder++;
+  r.cmd = cmd;
+  r.key = key;
+  r.kind = kind;
+  r.merge = true;
+  r.waiters.push_back(Waiter{ id, tag });
+  queue[prio].push_back(std::move(r));
+}
+
+uint8_t PONFDaemon::classify(const std::string &cmd, std::string &key, int &prio) {
+  size_t j, sep;
+
+  key.clear();
+  prio = PONFD_PRIO_NORMAL;
+
+  for(j = 0; j < tableSize(statusTable); j++) {
+    if(cmd == statusTable[j]) {
+      key = cmd;
+      prio = PONFD_PRIO_LOW;
+      return PONFD_KIND_STATUS;
+    }
+  }
+
+  for(j = 0; j < tableSize(shotTable); j++) {
+    if(cmd == shotTable[j]) {
+      prio = PONFD_PRIO_HIGH;
+      return PONFD_KIND_ACTION;
+    }
+  }
+  for(j = 0; j < tableSize(exposureTable); j++) {
+    if(startsWith(cmd, exposureTable[j])) {
+      prio = PONFD_PRIO_HIGH;
+      return PONFD_KIND_ACTION;
+    }
+  }
+
+  for(j = 0; j < tableSize(configTable); j++) {
+    if(!startsWith(cmd, configTable[j].name))
+      continue;
+    if(!configTable[j].perUnit) {
+      key = configTable[j].name;
+      return PONFD_KIND_CONFIG;
+    }
+    // The setting is the command with the motor or channel. The write
+    // of all the motors or channels overlaps the others, never coalesced
+    sep = cmd.find(CMD_PARAM_SEP);
+    key = cmd.substr(0, sep);
+    if(key == std::string(configTable[j].name) + "0") {
+      key.clear();
+      return PONFD_KIND_ACTION;
+    }
+    return PONFD_KIND_CONFIG;
+  }
+
+  return PONFD_KIND_ACTION;
+}
+
+PONFDaemon::Request* PONFDaemon::find(uint8_t kind, const std::string &key, bool queuedOnly) {
+  int p;
+
+  for(p = 0; p < PONFD_PRIOS; p++) {
+    for(auto &r : queue[p]) {
+      if( (r.kind == kind) && (r.key == key) && r.merge )
+        return &r;
+    }
+  }
+
+  if(!queuedOnly) {
+    for(auto &r : inFlight) {
+      if( (r.kind == kind) && (r.key == key) && r.merge )
+        return &r;
+    }
+  }
+
+  return NULL;
+}
+
+void PONFDaemon::barrier(uint8_t kind) {
+  int p;
+
+  for(p = 0; p < PONFD_PRIOS; p++) {
+    for(auto &r : queue[p]) {
+      if( (kind == PONFD_KIND_ACTION) || (r.kind == PONFD_KIND_STATUS) )
+        r.merge = false;
+    }
+  }
+  for(auto &r : inFlight) {
+    if( (kind == PONFD_KIND_ACTION) || (r.kind == PONFD_KIND_STATUS) )
+      r.merge = false;
+  }
+}
+
+bool PONFDaemon::changing(void) {
+  int p;
+
+  for(p = 0; p < PONFD_PRIOS; p++) {
+    for(auto &r : queue[p]) {
+      if(r.kind != PONFD_KIND_STATUS)
+        return true;
+    }
+  }
+  for(auto &r : inFlight) {
+    if(r.kind != PONFD_KIND_STATUS)
+      return true;
+  }
+
+  return false;
+}
+
+bool PONFDaemon::queued(unsigned long id) {
+  int p;
+
+  for(p = 0; p < PONFD_PRIOS; p++) {
+    for(auto &r : queue[p]) {
+      if(r.owner == id)
+        return true;
+    }
+  }
+
+  return false;
+}
+
+void PONFDaemon::submit(void) {
+  std::map<unsigned long, unsigned long> first;
+  std::list<Request>::iterator r;
+  int p;
+
+  while(inFlight.size() < PONFD_SUBMIT_MAX) {
+    // The first queued request of every process
+    first.clear();
+    for(p = 0; p < PONFD_PRIOS; p++) {
+      for(auto &q : queue[p]) {
+        auto f = first.insert(std::make_pair(q.owner, q.order));
+        if(q.order < f.first->second)
+          f.first->second = q.order;
+      }
+    }
+
+    // Every queue is in arrival order
+    for(p = 0; p < PONFD_PRIOS; p++) {
+      for(r = queue[p].begin(); (r != queue[p].end()) && (first[r->owner] != r->order); ++r)
+        ;
+      if(r != queue[p].end())
+        break;
+    }
+    if(p == PONFD_PRIOS)
+      return;
+
+    inFlight.splice(inFlight.end(), queue[p], r);
+    inFlight.back().reply = client.command(inFlight.back().cmd);
+    submitted++;
+  }
+}
+
+bool PONFDaemon::collect(void) {
+  PONFReply rep;
+  Buffer output;
+  bool done;
+
+  done = false;
+  for(auto r = inFlight.begin(); r != inFlight.end(); ) {
+    if(r->reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++r;
+      continue;
+    }
+
+    rep = r->reply.get();
+    output = std::make_shared<const std::string>(rep.output);
+
+    // Any other command can change the status
+    if(r->kind == PONFD_KIND_STATUS) {
+      if(rep.ok())
+        statusCache[r->key] = Status{ rep, output, std::chrono::steady_clock::now() };
+    }
+    else
+      statusCache.clear();
+    // Name not valid, the controller is not recording
+    if(startsWith(r->cmd, MC_REC) && !rep.ok())
+      recording = false;
+
+    reply(r->waiters, rep, output);
+    r = inFlight.erase(r);
+    done = true;
+  }
+
+  return done;
+}
+
+void PONFDaemon::reply(const std::vector<Waiter> &waiters, const PONFReply &rep, const Buffer &output) {
+  size_t lines;
+
+  lines = (output == nullptr) ? 0 : std::count(output->begin(), output->end(), '\n');
+
+  for(const Waiter &w : waiters) {
+    auto c = clients.find(w.client);
+    if(c == clients.end())
+      continue;   // Disconnected
+
+    if(c->second.out.size() > PONFD_OUT_MAX) {
+      shutdown(c->second.fd, SHUT_RDWR);
+      continue;
+    }
+    c->second.out.push_back(std::make_shared<const std::string>(w.tag + " " + rep.state + " " +
+      std::to_string(rep.micros) + " " + std::to_string(lines) + "\n"));
+    if(lines != 0)
+      c->second.out.push_back(output);
+  }
+}
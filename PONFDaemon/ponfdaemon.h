@@ -0,0 +1,275 @@
+/**
+ *  \file ponfdaemon.h
+ *  \brief CM3 daemon sharing the shutter controller link between processes
+ *
+ *  The daemon owns the serial or I2C link and accepts the requests of the
+ *  local processes (capture application, focus UI, monitoring) on a Unix
+ *  socket. Every request is a line:
+ *
+ *      <tag> <priority> <command>
+ *
+ *  where tag is chosen by the process to match the reply, priority is
+ *  0 (high) to 2 (low) or '-' for the default priority of the command.
+ *  The reply is:
+ *
+ *      <tag> <state> <micros> <lines>
+ *
+ *  followed by the lines of the command messages; state is the client
+ *  library reply state.
+ *
+ *  The link is never used for redundant traffic:
+ *  - the queued requests of the processes are sent in priority order,
+ *    keeping only a few commands in flight so an urgent shot is not queued
+ *    behind the others; the requests of a process are sent in order;
+ *  - a configuration write replaces the queued write of the same setting;
+ *  - the status reads are shared by the processes asking for the same
+ *    status and their result is cached for PONFD_STATUS_TTL_MS.
+ *
+ *  A request is never merged with the requests received before a command
+ *  that can change its result, and the cached status is not used while
+ *  such a command is pending. The requests of a process waiting for its
+ *  queued requests are not merged, they would be sent before them. The
+ *  writes are always sent, the daemon can't see a controller reset.
+ *  While a macro is recorded the requests are sent as received, in order,
+ *  without coalescing or caching.
+ *
+ *  The command messages are sent to all the processes waiting for them
+ *  from the same buffer.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _PONFDAEMON
+#define _PONFDAEMON
+
+#include <string>
+#include <deque>
+#include <map>
+#include <list>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include "../PONFClient/ponfclient.h"
+
+#define PONFD_SOCKET "/run/ponfd.sock"  ///< Default socket path
+#define PONFD_MAX_CLIENTS 16            ///< Max processes connected
+#define PONFD_LINE_MAX 256              ///< Max length of a request line
+#define PONFD_SUBMIT_MAX 2              ///< Max commands in flight on the link
+#define PONFD_STATUS_TTL_MS 500         ///< Validity (ms) of a cached status read
+
+#define PONFD_PRIO_HIGH 0     ///< Shots and trigger
+#define PONFD_PRIO_NORMAL 1   ///< Motors, configuration and the other commands
+#define PONFD_PRIO_LOW 2      ///< Status reads
+#define PONFD_PRIOS 3         ///< Number of priorities
+#define PONFD_PRIO_DEFAULT '-'  ///< Request priority: default of the command
+
+#define PONFD_KIND_ACTION 0   ///< Command with effects, always sent
+#define PONFD_KIND_CONFIG 1   ///< Configuration write, coalesced
+#define PONFD_KIND_STATUS 2   ///< Status read, shared and cached
+
+#define PONFD_STATE_BAD 'B'   ///< Reply state: malformed request or speed change
+
+/**
+ * \brief Unix socket server multiplexing the processes on the controller link
+ */
+class PONFDaemon {
+  public:
+
+    //! Requests received
+    unsigned long requests = 0;
+    //! Commands sent to the controller
+    unsigned long submitted = 0;
+    //! Configuration writes replaced by a later write
+    unsigned long coalesced = 0;
+    //! Status reads shared or answered from the cache
+    unsigned long cached = 0;
+
+    /**
+     * \param client The controller client, should be started by the caller
+     */
+    PONFDaemon(PONFClient &client);
+    ~PONFDaemon();
+
+    /**
+     * \brief Create the socket
+     *
+     * \param path The socket path, replaced if it exists
+     * \return false if the socket can't be created
+     */
+    bool begin(const std::string &path);
+
+    //! \brief Serve the processes until stop() is called
+    void run(void);
+
+    //! \brief Stop run(). Async signal safe
+    void stop(void);
+
+  private:
+    //! Shared output buffer
+    typedef std::shared_ptr<const std::string> Buffer;
+
+    /**
+     * Connected process
+     */
+    struct Client {
+      int fd;                     ///< Socket
+      std::string in;             ///< Partial request line
+      std::deque<Buffer> out;     ///< Buffers to send
+      size_t sent;                ///< Bytes of the first buffer already sent
+    };
+
+    /**
+     * Process waiting for a reply
+     */
+    struct Waiter {
+      unsigned long client;       ///< Client ID
+      std::string tag;            ///< Request tag
+    };
+
+    /**
+     * Command queued or in flight
+     */
+    struct Request {
+      unsigned long owner;              ///< ID of the client that queued the request
+      unsigned long order;              ///< Arrival number
+      std::string cmd;                  ///< Command
+      std::string key;                  ///< Coalescing key: the setting or the status command
+      uint8_t kind;                     ///< PONFD_KIND_ACTION, PONFD_KIND_CONFIG or PONFD_KIND_STATUS
+      bool merge;                       ///< The later requests can be merged with this one
+      std::vector<Waiter> waiters;      ///< Processes waiting for the reply
+      std::future<PONFReply> reply;     ///< Result, valid when submitted
+    };
+
+    /**
+     * Cached status read
+     */
+    struct Status {
+      PONFReply reply;                                ///< Result
+      Buffer output;                                  ///< Messages, shared by the replies
+      std::chrono::steady_clock::time_point time;     ///< Time of the read
+    };
+
+    //! Controller client
+    PONFClient &client;
+    //! Listening socket
+    int listenFd = -1;
+    //! Wake up pipe, written by the client receiver and by stop()
+    int wakeFd[2] = { -1, -1 };
+    //! Socket path
+    std::string path;
+    //! The server is running
+    volatile bool running = false;
+    //! Connected processes by ID
+    std::map<unsigned long, Client> clients;
+    //! Next client ID
+    unsigned long nextClient = 1;
+    //! Arrival number of the next queued request
+    unsigned long nextOrder = 1;
+    //! Queued requests by priority
+    std::list<Request> queue[PONFD_PRIOS];
+    //! Requests in flight
+    std::list<Request> inFlight;
+    //! A macro is being recorded by the controller
+    bool recording = false;
+    //! Status reads cache, by command
+    std::map<std::string, Status> statusCache;
+
+    //! \brief Accept a new process
+    void accept(void);
+
+    /**
+     * \brief Read the requests of a process
+     *
+     * \param id The client ID
+     * \return false if the process has disconnected
+     */
+    bool receive(unsigned long id);
+
+    /**
+     * \brief Send the pending replies of a process
+     *
+     * \param id The client ID
+     * \return false if the process has disconnected
+     */
+    bool transmit(unsigned long id);
+
+    /**
+     * \brief Queue, coalesce or answer a request line
+     *
+     * \param id The client ID
+     * \param line The request
+     */
+    void request(unsigned long id, const std::string &line);
+
+    /**
+     * \brief Send the queued requests up to PONFD_SUBMIT_MAX in flight
+     *
+     * The first queued request of every process is a candidate, the one
+     * with the highest priority is sent first, then the oldest. A request
+     * never overtakes an earlier request of the same process.
+     */
+    void submit(void);
+
+    /**
+     * \brief Deliver the replies of the requests completed
+     *
+     * \return true if some requests have completed
+     */
+    bool collect(void);
+
+    /**
+     * \brief Send a reply to the waiters
+     *
+     * \param waiters The processes waiting
+     * \param reply The result
+     * \param output The messages, shared by all the replies
+     */
+    void reply(const std::vector<Waiter> &waiters, const PONFReply &reply, const Buffer &output);
+
+    /**
+     * \brief Classify a command
+     *
+     * \param cmd The command
+     * \param key The coalescing key
+     * \param prio The default priority
+     * \return PONFD_KIND_ACTION, PONFD_KIND_CONFIG or PONFD_KIND_STATUS
+     */
+    uint8_t classify(const std::string &cmd, std::string &key, int &prio);
+
+    /**
+     * \brief Find a queued or in flight request
+     *
+     * \param kind The request kind
+     * \param key The coalescing key
+     * \param queuedOnly Ignore the requests in flight
+     * \return The request or NULL
+     */
+    Request* find(uint8_t kind, const std::string &key, bool queuedOnly);
+
+    /**
+     * \brief Stop merging the later requests with the ones received before
+     * a command or a write
+     *
+     * \param kind The kind of the request received
+     */
+    void barrier(uint8_t kind);
+
+    /**
+     * \brief Check if a command that can change the status is queued or
+     * in flight
+     *
+     * \return true if the cached status reads can be out of date
+     */
+    bool changing(void);
+
+    /**
+     * \brief Check if a process has queued requests
+     *
+     * \param id The client ID
+     * \return true if some requests of the process are not sent yet
+     */
+    bool queued(unsigned long id);
+};
+
+#endif
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+Daemon tests on the controller simulator.
+
+Starts ../../PONFClient/test/ponfsim.py and the daemon on its pseudo
+terminal, then checks the requests of two processes against the
+commands executed by the simulator.
+
+usage: testdaemon.py <ponfd>
+
+Licensed under GNU LGPL 3.0
+"""
+
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import traceback
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SIM = os.path.join(HERE, "..", "..", "PONFClient", "test", "ponfsim.py")
+STATUS_TTL = 0.5    # PONFD_STATUS_TTL_MS
+REPLY_TIMEOUT = 3.0
+
+
+class Process:
+    """A process connected to the daemon"""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.sock.settimeout(REPLY_TIMEOUT)
+        self.buf = b''
+        self.replies = {}
+
+    def send(self, tag, cmd, prio='-'):
+        self.sock.sendall(("%s %s %s\n" % (tag, prio, cmd)).encode())
+
+    def line(self):
+        while b'\n' not in self.buf:
+            data = self.sock.recv(4096)
+            if not data:
+                raise EOFError("daemon closed the connection")
+            self.buf += data
+        line, self.buf = self.buf.split(b'\n', 1)
+        return line.decode()
+
+    def reply(self, tag):
+        """Wait for the reply of a request: (state, lines)"""
+        while tag not in self.replies:
+            t, state, _, lines = self.line().split(' ')
+            self.replies[t] = (state, [self.line() for _ in range(int(lines))])
+        return self.replies.pop(tag)
+
+
+class Test:
+    def __init__(self, ponfd):
+        self.dir = tempfile.mkdtemp()
+        self.log = os.path.join(self.dir, "sim.log")
+        self.path = os.path.join(self.dir, "ponfd.sock")
+        self.sim = subprocess.Popen([sys.executable, "-u", SIM, "-l", self.log], stdout=subprocess.PIPE)
+        tty = self.sim.stdout.readline().decode().strip()
+        self.daemon = subprocess.Popen([ponfd, "-s", tty, "-l", self.path])
+        for _ in range(50):
+            if os.path.exists(self.path):
+                break
+            time.sleep(0.1)
+        self.executed = 0
+
+    def close(self):
+        self.daemon.terminate()
+        self.daemon.wait()
+        self.sim.kill()
+        self.sim.wait()
+
+    def commands(self):
+        """Commands executed by the simulator since the last call"""
+        with open(self.log) as f:
+            lines = f.read().splitlines()
+        new, self.executed = lines[self.executed:], len(lines)
+        return new
+
+    def busy(self, p):
+        """Keep the link busy for 400 ms, the next requests are queued by the daemon"""
+        p.send("busy1", "slow1")
+        p.send("busy2", "slow2")
+        time.sleep(0.05)
+
+    def idle(self, p):
+        assert p.reply("busy1")[0] == 'C'
+        assert p.reply("busy2")[0] == 'C'
+
+    # ===============================================================
+    # Tests
+    # ===============================================================
+
+    def test_bad(self, a, b):
+        a.send("1", "conf", '7')
+        a.send("2", "serBaud460800")
+        a.sock.sendall(b"nospace\n")
+        assert a.reply("1")[0] == 'B'
+        assert a.reply("2")[0] == 'B'
+        assert a.reply("nospace")[0] == 'B'
+        assert self.commands() == []
+
+    def test_barrier(self, a, b):
+        self.busy(a)
+        a.send("1", "conf")
+        a.send("2", "logLevel2")
+        a.send("3", "one")
+        b.send("4", "conf")
+        b.send("5", "logLevel3")
+        self.idle(a)
+        for tag in ("1", "2", "3"):
+            assert a.reply(tag)[0] == 'C'
+        for tag in ("4", "5"):
+            assert b.reply(tag)[0] == 'C'
+        # Nothing is merged across the command
+        assert self.commands() == ["slow1", "slow2", "conf", "logLevel2", "one", "conf", "logLevel3"]
+
+    def test_coalesce(self, a, b):
+        self.busy(a)
+        a.send("1", "logLevel2")
+        b.send("2", "logLevel3")
+        self.idle(a)
+        # The queued write is replaced, both processes get the reply
+        assert a.reply("1")[0] == 'C'
+        assert b.reply("2")[0] == 'C'
+        assert self.commands() == ["slow1", "slow2", "logLevel3"]
+
+        # The same value is written again, the controller may have been reset
+        b.send("3", "logLevel3")
+        assert b.reply("3")[0] == 'C'
+        assert self.commands() == ["logLevel3"]
+
+    def test_status(self, a, b):
+        time.sleep(STATUS_TTL)
+        self.busy(a)
+        a.send("1", "conf")
+        b.send("2", "conf")
+        self.idle(a)
+        # Shared by the two processes, with the messages
+        assert a.reply("1") == ('C', ["run conf"])
+        assert b.reply("2") == ('C', ["run conf"])
+        assert self.commands() == ["slow1", "slow2", "conf"]
+
+        # Cached, then read again when expired or after a command
+        b.send("3", "conf")
+        assert b.reply("3") == ('C', ["run conf"])
+        assert self.commands() == []
+        time.sleep(STATUS_TTL)
+        b.send("4", "conf")
+        assert b.reply("4")[0] == 'C'
+        b.send("5", "one")
+        b.send("6", "conf")
+        assert b.reply("5")[0] == 'C'
+        assert b.reply("6")[0] == 'C'
+        assert self.commands() == ["conf", "one", "conf"]
+
+    def test_priority(self, a, b):
+        self.busy(a)
+        a.send("1", "stats")
+        a.send("2", "one")
+        b.send("3", "125")
+        self.idle(a)
+        for tag in ("1", "2"):
+            assert a.reply(tag)[0] == 'C'
+        assert b.reply("3")[0] == 'C'
+        assert self.commands() == ["slow1", "slow2", "125", "stats", "one"]
+
+    def test_order(self, a, b):
+        self.busy(a)
+        a.send("1", "shRelease0")
+        a.send("2", "125")
+        b.send("3", "250")
+        b.send("4", "shRelease500")
+        self.idle(a)
+        for tag in ("1", "2"):
+            assert a.reply(tag)[0] == 'C'
+        for tag in ("3", "4"):
+            assert b.reply(tag)[0] == 'C'
+        # The shot of a process is not sent before its earlier write, nor
+        # the write of a waiting process merged with the queued one
+        assert self.commands() == ["slow1", "slow2", "250", "shRelease0", "125", "shRelease500"]
+
+    def test_macro(self, a, b):
+        self.busy(a)
+        cmds = ["mcRecm", "logLevel1", "logLevel1", "conf", "125", "mcEnd"]
+        for j, cmd in enumerate(cmds):
+            a.send(str(j), cmd)
+        self.idle(a)
+        for j in range(len(cmds)):
+            assert a.reply(str(j))[0] == 'C'
+        # Recorded as received, nothing coalesced or cached
+        assert self.commands() == ["slow1", "slow2"] + cmds
+
+    def run(self):
+        failures = 0
+        a = Process(self.path)
+        b = Process(self.path)
+        for name in sorted(n for n in dir(self) if n.startswith("test_")):
+            try:
+                getattr(self, name)(a, b)
+                print("%s: passed" % name)
+            except Exception:
+                traceback.print_exc()
+                print("%s: FAILED" % name)
+                failures += 1
+                # Skip the replies and the commands of the failed test
+                time.sleep(1)
+                a, b = Process(self.path), Process(self.path)
+                self.commands()
+        return failures
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s <ponfd>\n" % sys.argv[0])
+        return 2
+
+    test = Test(sys.argv[1])
+    try:
+        failures = test.run()
+    finally:
+        test.close()
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -19,6 +19,19 @@
 #include "commands.h"
 #include "motorcontrol.h"
 #include "shutter.h"
+#include "intervalometer.h"
+#include "macro.h"
+#include "analogdc.h"
+#include "power.h"
+#include "profile.h"
+#include "thermal.h"
+#include "fastpin.h"
+#include "scheduler.h"
+#include "capture.h"
+#include "stats.h"
+#include "framelink.h"
+#include "console.h"
+#include "shottimer.h"
 
 //! I2C Slave address. Set this up depending on the I2C other peripheral usage
 #define SLAVE_ADDRESS 0x04
@@ -26,20 +39,192 @@
 //! Define SERIALCONTROL if commands should be sent through USB to serial interface
 #define _SERIALCONTROL
 
+//! Define FRAMED if the serial commands are sent in frames with CRC and retransmit
+//! (see framelink.h) instead of plain lines. Needed to change the serial speed
+#undef _FRAMED
+
 //! Define I2CCONTROL if commands should be sent through I2C connection
 #undef _I2CCONTROL
 
+//! Enable the low power mode after the idle timeout
+#define _IDLE
+
+//! Enable the external trigger input and the chained trigger output
+#define _TRIGGER
+
+//! Enable the shutter end of travel input. The shutter motor cycle stops when
+//! the mechanism is cocked instead of after the fixed SH_MOTOR_MS time
+#undef _ENDSTOP
+
+//! Enable the acknowledge interrupt output to the master. The pin goes high
+//! when a tagged command completes and low when the master reads the status
+#define _ACKIRQ
+
 //! Enable the shooting marker pin for timing test on different values of shooting
 //! for test purpose only, disable in production.
 #undef _SHOTMARK
 
 
-//! I2C data string
-String wData;
+//! Serial command line being received, null terminated when complete
+char serialLine[CMD_LINE_MAX + 1];
+//! Characters of the serial line received, above CMD_LINE_MAX if the line is too long
+int serialLen = 0;
+
+//! I2C frame received, null terminated
+char wData[I2C_FRAME_MAX + 1];
+//! Status register sent back to the I2C master: the status of the commands of the
+//! last frame or the last acknowledge if the commands are tagged with a sequence ID.
+//! It is read by the I2C callback so it is written only by setStatus()
+char wStatus[I2C_STATUS_MAX + 1];
+//! An I2C frame has been received and is waiting to be executed by the main loop
+volatile boolean wPending = false;
+//! An I2C frame has been discarded because the previous one was still running.
+//! The master reads the busy status once, then the status register again
+volatile boolean wBusy = false;
 
 //! Motor control class instance
 MotorControl motor;
 
+//! Timelapse scheduler instance
+Intervalometer timelapse;
+
+//! Command macros instance
+MacroStore macros;
+
+//! Manual duty cycle pot sampler instance
+AnalogDC analogDC;
+
+//! Idle policy instance
+PowerManager power;
+
+//! Configuration profiles instance
+ProfileStore profiles;
+
+//! Thermal governor instance
+ThermalGovernor thermal;
+
+//! Commands table. The macros store the command IDs so the
+//! dispatch does not depend on the table order
+const commandDef commandTable[] = {
+  { SHOW_CONF, CID_CONF, 0, 0 },
+  { SH_MOTOR_INIT, CID_SH_INIT, 0, 0 },
+  { SH_MOTOR_CYCLE, CID_SH_CYCLE, 0, 0 },
+  { SH_ARM, CID_SH_ARM, 0, 0 },
+  { SH_FIRE, CID_SH_FIRE, 0, 1 },
+  { SH_TOP_LOCK, CID_SH_TOPLOCK, 0, 0 },
+  { SH_TOP_UNLOCK, CID_SH_TOPUNLOCK, 0, 0 },
+  { SH_BOTTOM_LOCK, CID_SH_BOTTOMLOCK, 0, 0 },
+  { SH_BOTTOM_UNLOCK, CID_SH_BOTTOMUNLOCK, 0, 0 },
+  { SHOT_8S, CID_SHOT, 8000, 0 },
+  { SHOT_4S, CID_SHOT, 4000, 0 },
+  { SHOT_2S, CID_SHOT, 2000, 0 },
+  { SHOT_1S, CID_SHOT, 1000, 0 },
+  { SHOT_2, CID_SHOT, 500, 0 },
+  { SHOT_4, CID_SHOT, 250, 0 },
+  { SHOT_8, CID_SHOT, 125, 0 },
+  { SHOT_15, CID_SHOT, 66, 0 },
+  { SHOT_30, CID_SHOT, 33, 0 },
+  { SHOT_60, CID_SHOT, 16, 0 },
+  { SHOT_125, CID_SHOT, 6, 0 },
+  { SHOT_250, CID_SHOT, 4, 0 },
+  { SHOT_400, CID_SHOT, 2, 0 },
+  { SHOT_1000, CID_SHOT, 1, 0 },
+  { SHOT_MULTI125, CID_MULTISHOT, 6, 0 },
+  { SHOT_MULTI250, CID_MULTISHOT, 4, 0 },
+  { SHOT_MULTI400, CID_MULTISHOT, 2, 0 },
+  { SHOT_MULTI1000, CID_MULTISHOT, 1, 0 },
+  { TL_START, CID_TL_START, 0, 3 },
+  { TL_PAUSE, CID_TL_PAUSE, 0, 0 },
+  { TL_RESUME, CID_TL_RESUME, 0, 0 },
+  { TL_STOP, CID_TL_STOP, 0, 0 },
+  { TL_INFO, CID_TL_INFO, 0, 0 },
+  { TRG_ARM, CID_TRG_ARM, 0, 1 },
+  { TRG_DISARM, CID_TRG_DISARM, 0, 0 },
+  { TRG_FIRE, CID_TRG_FIRE, 0, 0 },
+  { LOG_SET_LEVEL, CID_LOG_LEVEL, 0, 1 },
+  { LOG_SHOW_INFO, CID_LOG_INFO, 0, 0 },
+  { MOTOR_PWM, CID_MOTOR_PWM, 0, 3 },
+  { MOTOR_MOVE, CID_MOTOR_MOVE, 0, 3 },
+  { PWM_FREQ, CID_PWM_FREQ, 0, 2 },
+  { MANUAL_DC, CID_MANUAL_DC, 0, 2 },
+  { INFO_DC, CID_INFO_DC, 0, 0 },
+  { IDLE_TIMEOUT, CID_IDLE_TIMEOUT, 0, 1 },
+  { IDLE_INFO, CID_IDLE_INFO, 0, 0 },
+  { PROF_SAVE, CID_PROF_SAVE, 0, 1 },
+  { PROF_LOAD, CID_PROF_LOAD, 0, 1 },
+  { PROF_BOOT, CID_PROF_BOOT, 0, 1 },
+  { PROF_INFO, CID_PROF_INFO, 0, 0 },
+  { TH_INFO, CID_TH_INFO, 0, 0 },
+  { MOTOR_STAGGER, CID_MOTOR_STAGGER, 0, 2 },
+  { MOTOR_STOP_MODE, CID_MOTOR_STOP_MODE, 0, 3 },
+  { SH_RELEASE, CID_SH_RELEASE, 0, 1 },
+  { SH_CYCLE_INFO, CID_SH_CYCLE_INFO, 0, 0 },
+  { SH_CYCLE_RESET, CID_SH_CYCLE_RESET, 0, 0 },
+  { SCH_INFO, CID_SCH_INFO, 0, 0 },
+  { SCH_RESET, CID_SCH_RESET, 0, 0 },
+  { CAP_START, CID_CAP_START, 0, 0 },
+  { CAP_STOP, CID_CAP_STOP, 0, 0 },
+  { CAP_DUMP, CID_CAP_DUMP, 0, 0 },
+  { CAP_REPLAY, CID_CAP_REPLAY, 0, 0 },
+  { CAP_INFO, CID_CAP_INFO, 0, 0 },
+  { STATS_SHOW, CID_STATS_SHOW, 0, 0 },
+  { STATS_RESET, CID_STATS_RESET, 0, 0 },
+  { SER_BAUD, CID_SER_BAUD, 0, 1 },
+  { SER_INFO, CID_SER_INFO, 0, 0 }
+};
+
+//! Number of entries in the commands table
+#define COMMAND_TABLE_SIZE (sizeof(commandTable) / sizeof(commandDef))
+
+//! The shutter has been loaded and the bottom window is locked
+boolean shutterArmed = false;
+
+//! Shutter top window pin
+FastPin shTop;
+//! Shutter bottom window pin
+FastPin shBottom;
+//! Shot marker pin
+FastPin shotMark;
+//! Trigger output pin
+FastPin trgOut;
+//! Delay (us) between the bottom window release and the top window opening
+unsigned int shutterReleaseUs = SH_RELEASE_US;
+
+//! The trigger input accepts the next edge
+volatile boolean triggerArmed = false;
+//! The trigger edge has opened the shutter and the shot should be completed
+volatile boolean triggerFired = false;
+//! The shot timer has closed the top window of the trigger shot
+volatile boolean triggerClosed = false;
+//! Time of the trigger edge (micros)
+volatile unsigned long triggerTime;
+//! Exposure (ms) of the shot started by the trigger
+int triggerExposure;
+//! Time (us) from the top window opening to its closing of the trigger shot:
+//! the shutter motor cycle and the exposure
+unsigned long triggerOpenUs;
+
+//! Shutter motor cycles statistics
+shutterCycle shCycle;
+
+//! Tasks of the main loop in priority order: name, function, period (ms), budget (us).
+//! The shutter and commands tasks last as long as the shot or the command,
+//! so their budget is only a reference for the statistics
+schedTask tasks[] = {
+  { "shutter", taskShutter, TASK_EVENT, TASK_BUDGET_SHUTTER_US },
+  { "cmd", taskCommands, TASK_EVENT, TASK_BUDGET_COMMAND_US },
+  { "adc", taskADC, ANALOG_SAMPLE_MS, TASK_BUDGET_ADC_US },
+  { "ramp", taskRamp, ANALOG_DC_STEP_MS, TASK_BUDGET_RAMP_US },
+  { "diag", taskDiagnostic, TLE_HEALTH_CHECK_MS, TASK_BUDGET_DIAG_US },
+  { "tx", taskConsole, TASK_EVENT, TASK_BUDGET_CONSOLE_US }
+};
+
+//! Number of tasks in the table
+#define NUM_TASKS (sizeof(tasks) / sizeof(schedTask))
+
+//! Main loop scheduler instance
+Scheduler scheduler;
+
 //! If defined every command is echoed on the serial terminal
 //! despite if the I2C or UART is used to send commands
 #define _SERIAL_ECHO
@@ -48,13 +233,23 @@ MotorControl motor;
 // Initialisation
 // ==============================================
 void setup() {
+  motorProfile bootProfile;
+  unsigned long configStart;
+  boolean bootApplied;
+
   // Serial is initialised at high speed. If your Arduino boards
   // loose characters or show unwanted/unexpected behavior
   // try with a lower communication speed
-  Serial.begin(38400);
+  Serial.begin(frameLink.baud);
 
-  // initialize the motor class
-  motor.begin();  
+  // initialize the motor class with the boot profile if any
+  configStart = micros();
+  bootApplied = profiles.load(profiles.getBoot(), bootProfile);
+  if(bootApplied)
+    motor.begin(&bootProfile);
+  else
+    motor.begin();
+  profiles.configTime = micros() - configStart;
 
 #ifdef _I2CCONTROL
   // Initialize i2c as slave
@@ -64,51 +259,189 @@ void setup() {
   Wire.onRequest(i2cSendData);
 #endif
 
-  pinMode(SH_TOP, OUTPUT);
-  pinMode(SH_BOTTOM, OUTPUT);
-  pinMode(SHOT_MARK, OUTPUT); // for testing only
+  shTop.begin(SH_TOP);
+  shBottom.begin(SH_BOTTOM);
+  shotMark.begin(SHOT_MARK); // for testing only
+
+#ifdef _ACKIRQ
+  pinMode(ACK_IRQ, OUTPUT);
+  digitalWrite(ACK_IRQ, 0);
+#endif
+
+#ifdef _ENDSTOP
+  pinMode(SH_END_STOP, INPUT_PULLUP);
+#endif
+
+#ifdef _TRIGGER
+  trgOut.begin(TRIGGER_OUT);
+  trgOut.set();
+  shotTimer.begin();
+  pinMode(TRIGGER_IN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(TRIGGER_IN), triggerISR, FALLING);
+#endif
+
+  // The boot profile already holds the shutter motor settings
+  if(!bootApplied)
+    configShutterMotor();
+  initShutterWindows();
+  resetShutterCycle();
 
-  initShutterMotor();
+  scheduler.begin(tasks, NUM_TASKS);
 
   // Print the initialisation message
   Serial.println(APP_TITLE);
+  profiles.bootTime = micros();
+  CONSOLE_LOG(LOG_INFO) << PF_MSG_READY << profiles.bootTime << PF_MSG_CONFIG << profiles.configTime << endl;
 }
 
 // ==============================================
 // Main loop
 // ==============================================
 /** 
- * The main loop role is execturing the service functions; display update, 
- * checking.
+ * The main loop role is execturing the service functions through the
+ * cooperative scheduler; see the tasks table.
  * 
  * \note tHE i2c Data availability and reading from master is implemented in a
- * callback function. Data reading enable the command parsing immediately then
- * the function come back to the main loop cycle processing the other statuses
+ * callback function. The received frame is executed by the commands task.
  * 
  * \warning The diagnostic check based on the status of the motors running has been
  * removed from the loop as the motos control methods check by themselves the
  * diagnostic status of the TLE when a command involving a motor is executed.
+ * The diagnostic task only polls the chip for resets and temperature events.
  */
 void loop() {
+  unsigned long start;
 
-#ifdef _SERIALCONTROL
+#ifdef _IDLE
   // -------------------------------------------------------------
-  // BLOCK 2 : SERIAL PARSING
+  // LOW POWER MODE
   // -------------------------------------------------------------
-  // Serial commands parser
-  if(Serial.available() > 0){
-    parseCommand(Serial.readString());
-  } // serial available
+  // The motor control is stopped while sleeping: not with running motors
+  if(power.isIdle() && !motor.hasManualDC && !motor.isBusy())
+    idleSleep();
 #endif
 
+  start = micros();
+  scheduler.run();
+  stats.loop(micros() - start);
+
 } // Main loop
 
+// ==============================================
+// Scheduler tasks
+// ==============================================
+
+//! Shutter task: shots started by the external trigger and the timelapse.
+//! The trigger shot has been opened by the interrupt and is completed by the task
+void taskShutter(void) {
+#ifdef _TRIGGER
+  shotTimer.poll();
+  if(triggerFired)
+    completeTrigger();
+#endif
+
+  if(timelapse.isDue()) {
+    shot(timelapse.exposure);
+    timelapse.frameDone();
+    power.activity();
+  }
+}
+
+//! Commands task: parse and execute the serial line or the I2C frame received.
+//! The serial is read without waiting, a line is executed when its end is received
+void taskCommands(void) {
+#ifdef _SERIALCONTROL
+#ifdef _FRAMED
+  if(frameLink.receive()) {
+    String line = frameLink.payload();
+    capture.command(CAP_CMD_SERIAL, line);
+    parseCommand(line);
+    frameLink.applyBaud();
+  }
+  frameLink.poll();
+#else
+  if(receiveLine()) {
+    capture.command(CAP_CMD_SERIAL, serialLine);
+    parseCommand(serialLine);
+  }
+#endif
+#endif
+
+#ifdef _I2CCONTROL
+  if(wPending) {
+    capture.command(CAP_CMD_I2C, wData);
+    parseCommand(wData);
+    wPending = false;
+  }
+#endif
+}
+
+//! Collect the serial characters received until the end of a line.
+//! The lines too long are discarded, the empty lines are ignored
+//!
+//! \return true if a complete line is in serialLine
+boolean receiveLine(void) {
+  char c;
+
+  while(Serial.available() > 0) {
+    c = Serial.read();
+    if( (c != '\n') && (c != '\r') ) {
+      if(serialLen < CMD_LINE_MAX)
+        serialLine[serialLen] = c;
+      if(serialLen <= CMD_LINE_MAX)
+        serialLen++;
+      continue;
+    }
+
+    if(serialLen > CMD_LINE_MAX)
+      CONSOLE_LOG(LOG_WARNING) << CMD_TOOLONG << endl;
+    else if(serialLen > 0) {
+      serialLine[serialLen] = 0;
+      serialLen = 0;
+      return true;
+    }
+    serialLen = 0;
+  }
+
+  return false;
+}
+
+//! Analog sampling task: manual duty cycle pot
+void taskADC(void) {
+  if(analogDC.sample())
+    motor.lastAnalogDC = analogDC.value;
+}
+
+//! Ramp task: manual duty cycle steps and timed brake release
+void taskRamp(void) {
+  motor.motorPWMAnalogDC();
+  motor.motorBrakeRelease();
+}
+
+//! Diagnostic task: TLE94112 health check and thermal governor
+void taskDiagnostic(void) {
+  motor.tleHealthCheck();
+  thermal.update(motor);
+  timelapse.stretch = thermal.framePause();
+}
+
+//! Console task: send the queued output
+void taskConsole(void) {
+  console.drain();
+}
+
 // ==============================================
 // Shutter control functions
 // ==============================================
 
-//! Initialise the shutter motor
+//! Initialise the shutter motor and the shutter windows
 void initShutterMotor(void) {
+  configShutterMotor();
+  initShutterWindows();
+}
+
+//! Set the shutter motor default settings
+void configShutterMotor(void) {
   // Enable shutter motor
   motor.currentMotor = SH_MOTOR;
   motor.internalStatus[SH_MOTOR-1].isEnabled = true;
@@ -122,58 +455,391 @@ void initShutterMotor(void) {
   motor.setPWMRamp(RAMP_OFF);
   // Clockwise direction
   motor.setMotorDirection(MOTOR_DIRECTION_CCW);
+  // Brake on stop
+  motor.setMotorStopMode(SH_STOP_MODE, MOTOR_BRAKE_MS);
+}
 
-  // Initalises the shutter windows Both solenoids released
-  digitalWrite(SH_TOP, 0);
-  digitalWrite(SH_BOTTOM, 0);
+//! Initalises the shutter windows
+void initShutterWindows(void) {
+  // The trigger shot in progress is aborted
+  noInterrupts();
+  triggerArmed = false;
+  triggerFired = false;
+  shotTimer.stop();
+  interrupts();
+  // Both solenoids released
+  FastPin::write(shTop, 0, shBottom, 0);
+  capture.pin(SH_TOP, 0);
+  capture.pin(SH_BOTTOM, 0);
+  shutterArmed = false;
 }
 
-//! Exectues a single shutter motor cycle with delay
+//! Exectues a single shutter motor cycle. With the end of travel input
+//! the motor stops when the mechanism is cocked or after SH_CYCLE_TIMEOUT_US,
+//! else after the fixed SH_MOTOR_MS time.
+//!
+//! The end of travel input is polled while the motor runs. The input is
+//! ignored for SH_CYCLE_MIN_US, while the mechanism leaves the cocked position
 void cycleShutterMotorWithDelay(void) {
-  // Start-stop 100 ms test
+  unsigned long start, elapsed;
+#ifdef _ENDSTOP
+  boolean endReached;
+#endif
+
+  start = micros();
   motor.startMotor(SH_MOTOR);
+#ifdef _ENDSTOP
+  do {
+    elapsed = micros() - start;
+    endReached = (elapsed >= SH_CYCLE_MIN_US) && (digitalRead(SH_END_STOP) == LOW);
+  } while(!endReached && (elapsed < SH_CYCLE_TIMEOUT_US));
+#else
   delay(SH_MOTOR_MS);
+  elapsed = micros() - start;
+#endif
   motor.stopMotor(SH_MOTOR);
+
+  // Update the cycles statistics
+#ifdef _ENDSTOP
+  if(!endReached)
+    shCycle.timeouts++;
+#endif
+  shCycle.count++;
+  shCycle.last = elapsed;
+  shCycle.total += elapsed;
+  if(elapsed < shCycle.minTime)
+    shCycle.minTime = elapsed;
+  if(elapsed > shCycle.maxTime)
+    shCycle.maxTime = elapsed;
+}
+
+//! Reset the shutter motor cycles statistics
+void resetShutterCycle(void) {
+  shCycle.count = 0;
+  shCycle.timeouts = 0;
+  shCycle.last = 0;
+  shCycle.minTime = 0xFFFFFFFF;
+  shCycle.maxTime = 0;
+  shCycle.total = 0;
+}
+
+//! Show the shutter motor cycles statistics
+void showShutterCycle(void) {
+  CONSOLE_LOG(LOG_INFO) << SH_MSG_CYCLES << shCycle.count << SH_MSG_TIMEOUTS << shCycle.timeouts <<
+    SH_MSG_LAST << shCycle.last << SH_MSG_MIN << ((shCycle.count == 0) ? 0 : shCycle.minTime) <<
+    SH_MSG_MAX << shCycle.maxTime << SH_MSG_AVG << ((shCycle.count == 0) ? 0 : (shCycle.total / shCycle.count)) << endl;
 }
 
 //! Lock/unlock the shutter top window
 void shutterTop(boolean s) {
-  if(s)
-    digitalWrite(SH_TOP, 1);
-  else
-    digitalWrite(SH_TOP, 0);
+  shTop.write(s);
+  capture.pin(SH_TOP, s);
 }
 
 //! Lock/unlock the shutter bottom window
+//! Unlocking the bottom window releases the armed shutter
 void shutterBottom(boolean s) {
   if(s)
-    digitalWrite(SH_BOTTOM, 1);
-  else
-    digitalWrite(SH_BOTTOM, 0);
+    shBottom.set();
+  else {
+    shBottom.clear();
+    shutterArmed = false;
+    disarmTrigger();
+  }
+  capture.pin(SH_BOTTOM, s);
 }
 
 //! Shooting sequence
 //!
+//! If the shutter has not been armed in advance the arm phase is
+//! executed before firing.
+//!
 //! \param t shooting ms
 void shot(int t) {
+  // The shutter is used by the trigger shot until it is completed
+  if(triggerFired)
+    completeTrigger();
+  if(!shutterArmed)
+    armShutter();
+  fireShutter(t);
+}
+
+//! Arm the shutter: lock the bottom window and load the shutter
+//! then hold the mechanism ready to fire
+void armShutter(void) {
   // Lock bottom
-  digitalWrite(SH_BOTTOM, 1);
+  shBottom.set();
+  capture.pin(SH_BOTTOM, 1);
   // Load load shutter
   cycleShutterMotorWithDelay();
+  shutterArmed = true;
+}
 
-  // Shot
-  digitalWrite(SH_BOTTOM, 0);
-  delay(1);
-  digitalWrite(SH_TOP, 1);
+//! Fire the armed shutter: release, top open and timed close
+//!
+//! \param t shooting ms
+void fireShutter(int t) {
+  // The armed shutter is used by this shot, the trigger can't open it again
+  disarmTrigger();
+
+  openShutter();
+  exposeShutter(t);
+}
+
+//! Release the bottom and open the top window of the armed shutter, in the
+//! same write if there is no release delay
+void openShutter(void) {
+  if(shutterReleaseUs == 0)
+    FastPin::write(shBottom, 0, shTop, 1);
+  else {
+    shBottom.clear();
+    delayMicroseconds(shutterReleaseUs);
+    shTop.set();
+  }
+}
+
+//! Complete the shot after the shutter has been opened: shutter motor cycle
+//! and timed close of the top window
+//!
+//! \param t shooting ms
+void exposeShutter(int t) {
+  capture.pin(SH_BOTTOM, 0);
+  capture.pin(SH_TOP, 1);
   cycleShutterMotorWithDelay();
 #ifdef _SHOTMARK
-  digitalWrite(SHOT_MARK, 1);
+  shotMark.set();
 #endif
   delay(t);
 #ifdef _SHOTMARK
-  digitalWrite(SHOT_MARK, 0);
+  shotMark.clear();
+#endif
+  shTop.clear();
+  capture.pin(SH_TOP, 0);
+  shutterArmed = false;
+}
+
+// ==============================================
+// Motor functions
+// ==============================================
+
+//! Run a motor for a time then stop it according with its stop mode. The
+//! motor settings and the current motor are restored after the move, so
+//! the next startMotors() runs the motors as configured
+//!
+//! \param m The motor number (2-6, the shutter motor has its own cycle)
+//! \param dir MOTOR_DIRECTION_CW or MOTOR_DIRECTION_CCW
+//! \param t Time (ms)
+void moveMotor(int m, int dir, unsigned long t) {
+  int lastMotor = motor.currentMotor;
+  boolean lastEnabled = motor.internalStatus[m - 1].isEnabled;
+  int lastDirection = motor.internalStatus[m - 1].motorDirection;
+
+  motor.currentMotor = m;
+  motor.internalStatus[m - 1].isEnabled = true;
+  motor.setMotorDirection(dir);
+  motor.startMotor(m);
+  delay(t);
+  motor.stopMotor(m);
+
+  motor.internalStatus[m - 1].isEnabled = lastEnabled;
+  motor.internalStatus[m - 1].motorDirection = lastDirection;
+  motor.currentMotor = lastMotor;
+}
+
+// ==============================================
+// External trigger functions
+// ==============================================
+
+/**
+ * \brief Trigger input interrupt service routine
+ * 
+ * The edge is ignored if the trigger has not been armed. The leading edge
+ * of the trigger output starts the chained controllers and the armed
+ * shutter is released by the interrupt, so the shot start does not depend
+ * on the main loop. The following steps are timed by the shot timer from
+ * the edge: end of the trigger output pulse, top window opening after the
+ * release delay (at least the pulse), top window closing after the shutter
+ * motor cycle and the exposure. The shutter task runs the motor cycle.
+ */
+void triggerISR(void) {
+  if(!triggerArmed)
+    return;
+
+  triggerTime = micros();
+  triggerArmed = false;
+  triggerClosed = false;
+  trgOut.clear();
+  if(shutterReleaseUs == 0) {
+    FastPin::write(shBottom, 0, shTop, 1);
+#ifdef _SHOTMARK
+    shotMark.set();
 #endif
-  digitalWrite(SH_TOP, 0);
+  }
+  else
+    shBottom.clear();
+  shotTimer.start(TRIGGER_PULSE_US, triggerPulseEnd);
+  triggerFired = true;
+}
+
+//! Shot timer step: end of the trigger output pulse
+void triggerPulseEnd(void) {
+  trgOut.set();
+  if(shutterReleaseUs == 0)
+    shotTimer.start(triggerOpenUs - TRIGGER_PULSE_US, triggerClose);
+  else if(shutterReleaseUs <= TRIGGER_PULSE_US)
+    triggerOpen();
+  else
+    shotTimer.start(shutterReleaseUs - TRIGGER_PULSE_US, triggerOpen);
+}
+
+//! Shot timer step: top window opening after the release delay
+void triggerOpen(void) {
+  shTop.set();
+#ifdef _SHOTMARK
+  shotMark.set();
+#endif
+  shotTimer.start(triggerOpenUs, triggerClose);
+}
+
+//! Shot timer step: top window closing at the end of the exposure
+void triggerClose(void) {
+  shTop.clear();
+#ifdef _SHOTMARK
+  shotMark.clear();
+#endif
+  triggerClosed = true;
+}
+
+//! Complete the trigger shot: shutter motor cycle, then wait for the shot
+//! timer to close the top window if the exposure is not over yet
+void completeTrigger(void) {
+  capture.pin(SH_BOTTOM, 0);
+  capture.pin(SH_TOP, 1);
+  cycleShutterMotorWithDelay();
+  while(!triggerClosed)
+    shotTimer.poll();
+  capture.pin(SH_TOP, 0);
+
+  triggerFired = false;
+  shutterArmed = false;
+  power.activity();
+  CONSOLE_LOG(LOG_DEBUG) << CMD_TRIGGER << (micros() - triggerTime) << endl;
+}
+
+//! Disarm the trigger input, wherever the armed shutter is released or used
+//!
+//! \return true if the trigger was armed
+boolean disarmTrigger(void) {
+  boolean armed;
+
+  noInterrupts();
+  armed = triggerArmed;
+  triggerArmed = false;
+  interrupts();
+
+  return armed;
+}
+
+//! Send the trigger pulse to the chained controllers
+void pulseTriggerOut(void) {
+  trgOut.clear();
+  delayMicroseconds(TRIGGER_PULSE_US);
+  trgOut.set();
+}
+
+//! Arm the trigger input. The shutter is armed too, so the
+//! trigger only opens the windows
+//!
+//! \param t Exposure (ms) of the shot started by the trigger
+void armTrigger(int t) {
+  if(triggerFired)
+    completeTrigger();
+  if(!shutterArmed)
+    armShutter();
+  triggerExposure = t;
+  triggerOpenUs = (SH_MOTOR_MS + (unsigned long)t) * 1000UL;
+  triggerArmed = true;
+}
+
+// ==============================================
+// Capture replay
+// ==============================================
+
+/**
+ * \brief Replay the captured commands with their original timing
+ * 
+ * The time of the commands is relative to the replay start. While waiting
+ * for the next command the shutter, ramp and console tasks keep running, so
+ * the timelapse and trigger shots and the timed brake releases of the
+ * session are replayed too. The replay lasts until the time of the last
+ * captured event.
+ * 
+ * \return false if there is nothing to replay
+ */
+boolean replayCapture(void) {
+  unsigned long t;
+  String cmd;
+
+  if(!capture.beginReplay(motor))
+    return false;
+
+  while(capture.nextCommand(t, cmd)) {
+    while(capture.now() < t) {
+      taskShutter();
+      taskRamp();
+      taskConsole();
+    }
+    parseCommand(cmd);
+  }
+  while(capture.now() <= capture.lastTime) {
+    taskShutter();
+    taskRamp();
+    taskConsole();
+  }
+
+  capture.endReplay();
+  capture.showInfo();
+
+  return true;
+}
+
+// ==============================================
+// Low power functions
+// ==============================================
+
+/**
+ * \brief Stop the motor control and sleep until there is something to do
+ * 
+ * The core is halted until the next interrupt; on every wake up (the system
+ * tick included) the pending work is checked and if there is nothing the
+ * core goes back to sleep. On exit the motor control is restored before
+ * returning to the main loop and the restore time is measured.
+ */
+void idleSleep(void) {
+  unsigned long resumeStart;
+
+  CONSOLE_LOG(LOG_DEBUG) << PWR_MSG_SLEEP << endl;
+  console.flush();
+  motor.end();
+
+  while(!wakeRequest())
+    power.cpuSleep();
+
+  resumeStart = micros();
+  motor.restore();
+  power.resumed(micros() - resumeStart);
+}
+
+//! Check if there is some work for the main loop
+//!
+//! \return true if a command, a trigger or a timelapse frame is pending
+boolean wakeRequest(void) {
+  if(Serial.available() > 0)
+    return true;
+  if(wPending || triggerFired)
+    return true;
+
+  return timelapse.isDue();
 }
 
 // ==============================================
@@ -183,9 +849,7 @@ void shot(int t) {
 //! Send a message to the serial
 void serialMessage(String title, String description) {
 #ifdef _SERIAL_ECHO
-    Serial.print(title);
-    Serial.print(" ");
-    Serial.println(description);
+    CONSOLE_LOG(LOG_INFO) << title << " " << description << endl;
 #endif
 }
 
@@ -199,153 +863,640 @@ void serialMessage(String title, String description) {
  *  \param bytCount Number of bytes queued appended to command string
  */
 void i2cReceiveData(int byteCount){
+  int len;
+  char c;
 
-  wData = "";
+  // The previous frame is still running: the new one is discarded
+  if(wPending) {
+    while(Wire.available())
+      Wire.read();
+    wBusy = true;
+    return;
+  }
 
   // Data reading
+  len = 0;
   while(Wire.available()) {
-    wData += Wire.read(); // Queue 1 char to the string
+    c = (char)Wire.read();
+    if(len < I2C_FRAME_MAX)
+      wData[len++] = c;
   }
-  parseCommand(wData);
+  wData[len] = 0;
+  // The frame is executed by the main loop so the bus is not
+  // blocked until the commands complete
+  wPending = true;
   
 }
 
 /**
  *  \brief callback for sending data
  *  
- *  \param wData Data string to send to master
+ *  Sends to the master the status register, or the busy status if
+ *  the last frame has been discarded, and clears the acknowledge interrupt
  */
 void i2cSendData(){
-  Wire << wData;
-//  Wire.write(wData);
+  if(wBusy) {
+    Wire << CMD_BUSY;
+    wBusy = false;
+  }
+  else
+    Wire << wStatus;
+#ifdef _ACKIRQ
+  digitalWrite(ACK_IRQ, 0);
+#endif
 }
 
 /** ***********************************************************
- * Parse the command string and echo the executing message or 
- * command unknown error.
+ * Parse a frame with one or more commands separated by CMD_SEP
+ * and execute them in sequence.
+ * 
+ * The trailing CR/LF (if any) are removed before parsing so the
+ * same function is used for the serial terminal and I2C frames.
+ * When the frame contains more than one command the status of
+ * every command is also shown on the serial terminal.
+ * 
+ * Every command can be tagged with a sequence ID in the format
+ * #<seq>:<command>. The tagged commands are acknowledged when
+ * accepted and when completed or failed. At the end of a frame with
+ * tagged commands the status register holds the last acknowledge
+ * followed by the status of all the frame commands.
  * 
- * The command is removed from the last two characters before
- * effective parsing. Use this function when the command comes
- * from a serial terminal
+ * The spaces and CR/LF around every command are ignored.
  * 
- * \param commandString the string coming from the serial+CRLF
+ * \param cmdString the string coming from the serial or I2C
  *  ***********************************************************
  */
  void parseCommand(String cmdString) {
-  int cmdlen;
-  String commandString;
+  String frameStatus;
+  int from, sep, cmdlen, seqEnd;
+  long seq;
+  boolean multiple, tagged, result;
+
+  power.activity();
+
+  cmdlen = cmdString.length();
+  while( (cmdlen > 0) && ((cmdString.charAt(cmdlen - 1) == '\r') || (cmdString.charAt(cmdlen - 1) == '\n')) )
+    cmdlen--;
+  cmdString.remove(cmdlen);
+
+  multiple = cmdString.indexOf(CMD_SEP) >= 0;
+  tagged = false;
+  from = 0;
+  do {
+    sep = cmdString.indexOf(CMD_SEP, from);
+    String command = (sep < 0) ? cmdString.substring(from) : cmdString.substring(from, sep);
+    from = sep + 1;
+    command.trim();
+
+    // Empty commands (e.g. a trailing separator) are ignored
+    if(command.length() == 0)
+      continue;
 
-  commandString = cmdString;
-  cmdlen = cmdString.length() - 2;
-  commandString.remove(cmdlen);
+    // Extract the sequence ID
+    seq = -1;
+    seqEnd = command.indexOf(CMD_SEQ_END);
+    if( (command.charAt(0) == CMD_SEQ_PREFIX) && (seqEnd > 1) ) {
+      seq = command.substring(1, seqEnd).toInt();
+      command = command.substring(seqEnd + 1);
+      tagged = true;
+      ackCommand(CMD_ACK_ACCEPTED, seq);
+    }
 
-  parseNoCRLF(commandString);
+    result = parseNoCRLF(command);
+
+    if(seq >= 0)
+      ackCommand(result ? CMD_ACK_COMPLETED : CMD_ACK_FAILED, seq);
+
+    if(frameStatus.length() > 0)
+      frameStatus += CMD_SEP;
+    frameStatus += result ? CMD_STATUS_OK : CMD_STATUS_FAIL;
+  } while(sep >= 0);
+
+  if(multiple)
+    serialMessage(CMD_STATUS, frameStatus);
+
+  // With tagged commands the status register keeps the last acknowledge
+  // and the status of all the frame commands
+  if(tagged)
+    setStatus(String(" ") + frameStatus, true);
+  else
+    setStatus(frameStatus, false);
  }
+
+/** ***********************************************************
+ * Write the I2C status register. The register is read by the
+ * I2C request callback, so it is a fixed buffer changed with
+ * the interrupts disabled.
+ * 
+ * \param status The status, truncated to I2C_STATUS_MAX
+ * \param append true to append the status to the register
+ *  ***********************************************************
+ */
+ void setStatus(const String &status, boolean append) {
+  String s;
+
+  s = append ? (String(wStatus) + status) : status;
+
+  noInterrupts();
+  s.toCharArray(wStatus, sizeof(wStatus));
+  interrupts();
+ }
+
+/** ***********************************************************
+ * Acknowledge a tagged command to the master.
+ * 
+ * The acknowledge is sent to the serial terminal and saved in the
+ * I2C status register in the format <state> <seq> <micros>. 
+ * When the command completes or fails the acknowledge interrupt
+ * is raised.
+ * 
+ * \param state The command state (accepted, completed, failed)
+ * \param seq The command sequence ID
+ *  ***********************************************************
+ */
+ void ackCommand(char state, long seq) {
+  String ack;
+
+  ack = String(state);
+  ack += " ";
+  ack += seq;
+  ack += " ";
+  ack += micros();
+
+  setStatus(ack, false);
+  // The acknowledges are part of the protocol and are never filtered nor
+  // dropped: the queued messages are sent first, then the acknowledge
+  console.bulk() << ack << endl;
+
+#ifdef _ACKIRQ
+  if(state != CMD_ACK_ACCEPTED)
+    digitalWrite(ACK_IRQ, 1);
+#endif
+ }
+
 /** ***********************************************************
  * Parse the command string and echo the executing message or 
  * command unknown error.
  * 
+ * The macro commands are managed first as they work on the macro
+ * names instead of decoded commands. If a macro is being recorded
+ * the other commands are decoded and added to the macro without
+ * executing them.
+ * 
  * \param cmdString the string coming from the serial+CRLF
+ * \return false if the command is unknown or failed
  *  ***********************************************************
  */
- void parseNoCRLF(String cmdString) {
+ boolean parseNoCRLF(String cmdString) {
+  dispatchEntry entry;
 
   // =========================================================
-  // Informative commands
+  // Macro commands
   // =========================================================
-  if(cmdString.equals(SHOW_CONF)) {
-    motor.showInfo();
+  if(cmdString.startsWith(MC_REC)) {
+    if(!macros.record(cmdString.substring(String(MC_REC).length()))) {
+      serialMessage(MC_MSG_TITLE, MC_MSG_BADNAME);
+      return false;
+    }
+    serialMessage(MC_MSG_TITLE, MC_MSG_RECORDING + String(macros.buffer.name));
   }
-  // =========================================================
-  // Shutter motor commands
-  // =========================================================
-  else if(cmdString.equals(SH_MOTOR_INIT)) {
-    initShutterMotor();
-  }
-  else if(cmdString.equals(SH_MOTOR_CYCLE)) {
-    cycleShutterMotorWithDelay();
+  else if(cmdString.equals(MC_END)) {
+    if(!macros.isRecording()) {
+      serialMessage(MC_MSG_TITLE, MC_MSG_NOTRECORDING);
+      return false;
+    }
+    if(!macros.save()) {
+      serialMessage(MC_MSG_TITLE, MC_MSG_FULL);
+      return false;
+    }
+    serialMessage(MC_MSG_TITLE, MC_MSG_SAVED + String(macros.buffer.name));
   }
-  // =========================================================
-  // Shutter window commands
-  // =========================================================
-  else if(cmdString.equals(SH_TOP_LOCK)) {
-    shutterTop(true);
+  else if(cmdString.startsWith(MC_RUN)) {
+    return runMacro(cmdString.substring(String(MC_RUN).length()));
   }
-  else if(cmdString.equals(SH_TOP_UNLOCK)) {
-    shutterTop(false);
+  else if(cmdString.startsWith(MC_DEL)) {
+    String name = cmdString.substring(String(MC_DEL).length());
+    if(!macros.remove(name)) {
+      serialMessage(MC_MSG_TITLE, MC_MSG_NOTFOUND + name);
+      return false;
+    }
+    serialMessage(MC_MSG_TITLE, MC_MSG_DELETED + name);
   }
-  else if(cmdString.equals(SH_BOTTOM_LOCK)) {
-    shutterBottom(true);
-  }
-  else if(cmdString.equals(SH_BOTTOM_UNLOCK)) {
-    shutterBottom(false);
+  else if(cmdString.equals(MC_LIST)) {
+    macros.showInfo();
   }
   // =========================================================
-  // Shooting commands (up to 1/1000)
+  // Dispatch table commands
   // =========================================================
-  else if(cmdString.equals(SHOT_8S)) {
-    shot(8000);
-  }
-  else if(cmdString.equals(SHOT_4S)) {
-    shot(4000);
-  }
-  else if(cmdString.equals(SHOT_2S)) {
-    shot(2000);
-  }
-  else if(cmdString.equals(SHOT_1S)) {
-    shot(1000);
-  }
-  else if(cmdString.equals(SHOT_2)) {
-    shot(500);
-  }
-  else if(cmdString.equals(SHOT_4)) {
-    shot(250);
-  }
-  else if(cmdString.equals(SHOT_8)) {
-    shot(125);
-  }
-  else if(cmdString.equals(SHOT_15)) {
-    shot(66);
-  }
-  else if(cmdString.equals(SHOT_30)) {
-    shot(33);
-  }
-  else if(cmdString.equals(SHOT_60)) {
-    shot(16);
-  }
-  else if(cmdString.equals(SHOT_125)) {
-    shot(6);
-  }
-  else if(cmdString.equals(SHOT_250)) {
-    shot(4);
-  }
-  else if(cmdString.equals(SHOT_400)) {
-    shot(2);
+  else if(!decodeCommand(cmdString, entry)) {
+    CONSOLE_LOG(LOG_WARNING) << CMD_WRONGCMD << " '" << cmdString << "'" << endl;
+    return false;
   }
-  else if(cmdString.equals(SHOT_1000)) {
-    shot(1);
+  else if(macros.isRecording()) {
+    if(!macros.add(entry)) {
+      serialMessage(MC_MSG_TITLE, MC_MSG_FULL);
+      return false;
+    }
+    serialMessage(MC_MSG_RECORDED, cmdString);
   }
-  else if(cmdString.equals(SHOT_MULTI125)) {
-    int j;
-    for(j = 0; j < MULTI_SHOOTING; j++)
-      shot(6);
+  else if(!timedCommand(entry)) {
+    CONSOLE_LOG(LOG_WARNING) << CMD_WRONGCMD << " '" << cmdString << "'" << endl;
+    return false;
   }
-  else if(cmdString.equals(SHOT_MULTI250)) {
-    int j;
-    for(j = 0; j < MULTI_SHOOTING; j++)
-      shot(4);
-  }
-  else if(cmdString.equals(SHOT_MULTI400)) {
-    int j;
-    for(j = 0; j < MULTI_SHOOTING; j++)
-      shot(2);
+
+  return true;
+ }
+
+/** ***********************************************************
+ * Decode a command string in a dispatch entry searching it
+ * in the commands table and converting the parameters
+ * 
+ * \param cmdString The command string without CR/LF
+ * \param entry The decoded command
+ * \return false if the command is unknown or the number of
+ * parameters is wrong
+ *  ***********************************************************
+ */
+ boolean decodeCommand(String cmdString, dispatchEntry &entry) {
+  unsigned int j;
+  const commandDef* def;
+
+  for(j = 0; j < COMMAND_TABLE_SIZE; j++) {
+    def = &commandTable[j];
+
+    if(def->numParams == 0) {
+      if(!cmdString.equals(def->name))
+        continue;
+    }
+    else if(!cmdString.startsWith(def->name))
+      continue;
+
+    entry.id = def->id;
+    entry.value = def->value;
+    entry.numParams = def->numParams;
+
+    if(def->numParams == 0)
+      return true;
+
+    return parseParams(cmdString.substring(strlen(def->name)), entry.params) == def->numParams;
   }
-  else if(cmdString.equals(SHOT_MULTI1000)) {
-    int j;
-    for(j = 0; j < MULTI_SHOOTING; j++)
-      shot(1);
+
+  return false;
+ }
+
+/** ***********************************************************
+ * Convert the comma separated numeric parameters of a command
+ * 
+ * \param params The parameters string
+ * \param values The converted values, up to CMD_MAX_PARAMS
+ * \return The number of parameters found
+ *  ***********************************************************
+ */
+ uint8_t parseParams(String params, long* values) {
+  uint8_t count;
+  int from, sep;
+
+  if(params.length() == 0)
+    return 0;
+
+  count = 0;
+  from = 0;
+  do {
+    if(count == CMD_MAX_PARAMS)
+      return CMD_MAX_PARAMS + 1; // Too many parameters
+
+    sep = params.indexOf(CMD_PARAM_SEP, from);
+    if(sep < 0)
+      values[count++] = params.substring(from).toInt();
+    else
+      values[count++] = params.substring(from, sep).toInt();
+    from = sep + 1;
+  } while(sep >= 0);
+
+  return count;
+ }
+
+/** ***********************************************************
+ * Execute a decoded command
+ * 
+ * \param entry The decoded command
+ * \return false if the command parameters are not valid
+ *  ***********************************************************
+ */
+ boolean executeCommand(const dispatchEntry &entry) {
+  int j, selected;
+
+  switch(entry.id) {
+    // =========================================================
+    // Informative commands
+    // =========================================================
+    case CID_CONF:
+      motor.showInfo();
+    break;
+    // =========================================================
+    // Shutter motor commands
+    // =========================================================
+    case CID_SH_INIT:
+      initShutterMotor();
+    break;
+    case CID_SH_CYCLE:
+      cycleShutterMotorWithDelay();
+    break;
+    case CID_SH_ARM:
+      if(!shutterArmed)
+        armShutter();
+    break;
+    case CID_SH_FIRE:
+      if(entry.params[0] <= 0)
+        return false;
+      shot(entry.params[0]);
+    break;
+    // =========================================================
+    // Shutter window commands
+    // =========================================================
+    case CID_SH_TOPLOCK:
+      shutterTop(true);
+    break;
+    case CID_SH_TOPUNLOCK:
+      shutterTop(false);
+    break;
+    case CID_SH_BOTTOMLOCK:
+      shutterBottom(true);
+    break;
+    case CID_SH_BOTTOMUNLOCK:
+      shutterBottom(false);
+    break;
+    case CID_SH_RELEASE:
+      if( (entry.params[0] < 0) || (entry.params[0] > SH_RELEASE_MAX_US) )
+        return false;
+      shutterReleaseUs = entry.params[0];
+    break;
+    case CID_SH_CYCLE_INFO:
+      showShutterCycle();
+    break;
+    case CID_SH_CYCLE_RESET:
+      resetShutterCycle();
+    break;
+    // =========================================================
+    // Shooting commands (up to 1/1000)
+    // =========================================================
+    case CID_SHOT:
+      shot(entry.value);
+    break;
+    case CID_MULTISHOT:
+      for(j = 0; j < MULTI_SHOOTING; j++) {
+        shot(entry.value);
+        // Cooling pause when throttling
+        delay(thermal.framePause());
+      }
+    break;
+    // =========================================================
+    // Timelapse commands
+    // =========================================================
+    case CID_TL_START:
+      if( (entry.params[0] <= 0) || (entry.params[1] < 0) ||
+          !timelapse.start(entry.params[0], entry.params[1], entry.params[2]) ) {
+        serialMessage(TL_MSG_TITLE, TL_MSG_BADPARAM);
+        return false;
+      }
+      timelapse.showInfo();
+    break;
+    case CID_TL_PAUSE:
+      timelapse.pause();
+      timelapse.showInfo();
+    break;
+    case CID_TL_RESUME:
+      timelapse.resume();
+      timelapse.showInfo();
+    break;
+    case CID_TL_STOP:
+      timelapse.stop();
+      timelapse.showInfo();
+    break;
+    case CID_TL_INFO:
+      timelapse.showInfo();
+    break;
+    // =========================================================
+    // External trigger commands
+    // =========================================================
+    case CID_TRG_ARM:
+      if(entry.params[0] <= 0)
+        return false;
+      armTrigger(entry.params[0]);
+      CONSOLE_LOG(LOG_INFO) << CMD_ARMED << entry.params[0] << endl;
+    break;
+    case CID_TRG_DISARM:
+      disarmTrigger();
+      serialMessage(CMD_TRIGGER, CMD_DISARMED);
+    break;
+    case CID_TRG_FIRE:
+      if(disarmTrigger()) {
+        pulseTriggerOut();
+        shot(triggerExposure);
+      }
+      else
+        serialMessage(CMD_TRIGGER, CMD_NOTARMED);
+    break;
+    // =========================================================
+    // Motors configuration commands
+    // =========================================================
+    case CID_MOTOR_STAGGER:
+      if( (entry.params[0] < 0) || (entry.params[1] < MOTOR_CURRENT_NORMAL) )
+        return false;
+      motor.setStartStagger(entry.params[0], entry.params[1]);
+      motor.showInfo();
+    break;
+    case CID_MOTOR_STOP_MODE:
+      if( (entry.params[0] < 0) || (entry.params[0] > MAX_MOTORS) ||
+          (entry.params[1] < MOTOR_STOP_COAST) || (entry.params[1] > MOTOR_STOP_TIMED) ||
+          (entry.params[2] < 0) || (entry.params[2] > MOTOR_BRAKE_MAX_MS) )
+        return false;
+      // The motor is a parameter, the selected motor is kept
+      selected = motor.currentMotor;
+      motor.currentMotor = entry.params[0];
+      motor.setMotorStopMode(entry.params[1], entry.params[2]);
+      motor.currentMotor = selected;
+      motor.showInfo();
+    break;
+    case CID_MOTOR_MOVE:
+      if( (entry.params[0] <= SH_MOTOR) || (entry.params[0] > MAX_MOTORS) ||
+          ((entry.params[1] != MOTOR_DIRECTION_CW) && (entry.params[1] != MOTOR_DIRECTION_CCW)) ||
+          (entry.params[2] <= 0) || (entry.params[2] > MOTOR_MOVE_MAX_MS) )
+        return false;
+      moveMotor(entry.params[0], entry.params[1], entry.params[2]);
+    break;
+    case CID_MOTOR_PWM:
+      j = motor.pwmFrequencyCode(entry.params[1]);
+      if( (entry.params[0] < 1) || (entry.params[0] > MAX_MOTORS) || (j < 0) ||
+          (entry.params[2] < DUTYCYCLE_MIN) || (entry.params[2] > DUTYCYCLE_MAX) )
+        return false;
+      selected = motor.currentMotor;
+      motor.currentMotor = entry.params[0];
+      j = motor.requestPWM(j, entry.params[2]);
+      motor.currentMotor = selected;
+      if(!j)
+        return false;
+      motor.showInfo();
+    break;
+    case CID_PWM_FREQ:
+      j = motor.pwmFrequencyCode(entry.params[1]);
+      if( (entry.params[0] < 0) || (entry.params[0] > AVAIL_PWM_CHANNELS) || (j <= 0) )
+        return false;
+      motor.currentPWM = entry.params[0];
+      motor.setPWMFrequency(j);
+      motor.showInfo();
+    break;
+    case CID_MANUAL_DC:
+      if( (entry.params[0] < 0) || (entry.params[0] > AVAIL_PWM_CHANNELS) )
+        return false;
+      motor.currentPWM = entry.params[0];
+      motor.setPWMManualDC(entry.params[1] != 0);
+      motor.showInfo();
+    break;
+    case CID_PROF_SAVE:
+      if(!profiles.save(entry.params[0], motor))
+        return false;
+      CONSOLE_LOG(LOG_INFO) << PF_MSG_TITLE << entry.params[0] << PF_MSG_SAVED << endl;
+    break;
+    case CID_PROF_LOAD:
+      {
+        motorProfile data;
+
+        if(!profiles.load(entry.params[0], data)) {
+          CONSOLE_LOG(LOG_WARNING) << PF_MSG_TITLE << entry.params[0] << PF_MSG_INVALID << endl;
+          return false;
+        }
+        motor.setProfile(data);
+        motor.apply();
+        CONSOLE_LOG(LOG_INFO) << PF_MSG_TITLE << entry.params[0] << PF_MSG_LOADED << endl;
+      }
+    break;
+    case CID_PROF_BOOT:
+      if(!profiles.setBoot(entry.params[0]))
+        return false;
+      profiles.showInfo();
+    break;
+    case CID_PROF_INFO:
+      profiles.showInfo();
+    break;
+    case CID_CAP_START:
+      if(!capture.start(motor))
+        return false;
+    break;
+    case CID_CAP_STOP:
+      capture.stop();
+      capture.showInfo();
+    break;
+    case CID_CAP_DUMP:
+      capture.dump();
+    break;
+    case CID_CAP_REPLAY:
+      if(!replayCapture())
+        return false;
+    break;
+    case CID_CAP_INFO:
+      capture.showInfo();
+    break;
+    case CID_SCH_INFO:
+      scheduler.showInfo();
+    break;
+    case CID_SCH_RESET:
+      scheduler.resetStats();
+    break;
+    case CID_STATS_SHOW:
+      stats.showInfo();
+    break;
+    case CID_STATS_RESET:
+      stats.reset();
+    break;
+    case CID_TH_INFO:
+      thermal.showInfo(motor);
+    break;
+    case CID_IDLE_TIMEOUT:
+      if(entry.params[0] < 0)
+        return false;
+      power.timeout = entry.params[0];
+      power.showInfo();
+    break;
+    case CID_IDLE_INFO:
+      power.showInfo();
+    break;
+    case CID_INFO_DC:
+      analogDC.showInfo();
+      for(j = 0; j < AVAIL_PWM_CHANNELS; j++)
+        CONSOLE_LOG(LOG_INFO) << CMD_PWM << (j + 1) << " " << motor.dutyCyclePWM[j].curDC <<
+          "/" << motor.dutyCyclePWM[j].maxDC << endl;
+    break;
+    // =========================================================
+    // Console commands
+    // =========================================================
+    case CID_LOG_LEVEL:
+      if( (entry.params[0] < LOG_NONE) || (entry.params[0] > LOG_DEBUG) )
+        return false;
+      console.level = entry.params[0];
+      console.showInfo();
+    break;
+    case CID_LOG_INFO:
+      console.showInfo();
+    break;
+    case CID_SER_BAUD:
+#ifdef _FRAMED
+      if(!frameLink.setBaud(entry.params[0]))
+        return false;
+#else
+      // Without the frames the new speed can't be confirmed
+      return false;
+#endif
+    break;
+    case CID_SER_INFO:
+      frameLink.showInfo();
+    break;
+    default:
+      return false;
   }
-  else
-    Serial << CMD_WRONGCMD << " '" << cmdString << "'" << endl;
+
+  return true;
  }
 
+/** ***********************************************************
+ * Execute a decoded command counting it in the runtime
+ * statistics with its execution time
+ * 
+ * \param entry The decoded command
+ * \return false if the command parameters are not valid
+ *  ***********************************************************
+ */
+ boolean timedCommand(const dispatchEntry &entry) {
+  unsigned long start;
+  boolean result;
+
+  start = micros();
+  result = executeCommand(entry);
+  stats.command(entry.id, micros() - start);
+
+  return result;
+ }
+
+/** ***********************************************************
+ * Load a stored macro and execute all its commands
+ * 
+ * \param name The macro name
+ * \return false if the macro does not exist or a command failed
+ *  ***********************************************************
+ */
+ boolean runMacro(String name) {
+  int j;
+  boolean result;
+
+  if(macros.isRecording() || !macros.load(name)) {
+    serialMessage(MC_MSG_TITLE, MC_MSG_NOTFOUND + name);
+    return false;
+  }
+
+  serialMessage(MC_MSG_TITLE, MC_MSG_RUNNING + name);
+  result = true;
+  for(j = 0; j < macros.buffer.numSteps; j++)
+    result &= timedCommand(macros.buffer.steps[j]);
+
+  return result;
+ }
@@ -0,0 +1,49 @@
+/**
+ *  \file analogdc.cpp
+ *  \brief This file defines functions and predefined instances from analogdc.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "analogdc.h"
+
+boolean AnalogDC::sample(void) {
+  uint8_t dc;
+
+  if((millis() - lastSample) < ANALOG_SAMPLE_MS)
+    return false;
+  lastSample = millis();
+
+  accumulator += analogRead(ANALOG_DC_PIN);
+  if(++count < ANALOG_OVERSAMPLE)
+    return false;
+
+  raw = accumulator >> ANALOG_OVERSAMPLE_SHIFT;
+  accumulator = 0;
+  count = 0;
+
+  // Fixed point low pass filter: filtered += raw - filtered / 2^n
+  if(!primed) {
+    filtered = raw << ANALOG_FILTER_SHIFT;
+    primed = true;
+  }
+  else
+    filtered = filtered + raw - (filtered >> ANALOG_FILTER_SHIFT);
+
+  dc = (filtered >> ANALOG_FILTER_SHIFT) >> (ANALOG_DC_BITS - 8);
+
+  // Accept the full scale values also inside the hysteresis band
+  // so the pot can reach the min and max duty cycle
+  if( (abs((int)dc - (int)value) >= ANALOG_HYSTERESIS) ||
+      ((dc != value) && ((dc == 0) || (dc == 255))) ) {
+    value = dc;
+    return true;
+  }
+
+  return false;
+}
+
+void AnalogDC::showInfo(void) {
+  CONSOLE_LOG(LOG_INFO) << ADC_MSG_TITLE << ADC_MSG_RAW << raw <<
+    ADC_MSG_FILTERED << (filtered >> ANALOG_FILTER_SHIFT) << ADC_MSG_VALUE << value << endl;
+}
@@ -0,0 +1,76 @@
+/**
+ *  \file analogdc.h
+ *  \brief Filtered analog input (pot) for the manual duty cycle
+ *
+ *  The input is sampled in background by the main loop, one conversion
+ *  every call at a fixed rate. The samples are averaged (oversampling),
+ *  smoothed by a first order low pass filter and the resulting duty
+ *  cycle changes only when the filtered value moves more than the
+ *  hysteresis, so the pot noise does not continuously update the PWM.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _ANALOGDC
+#define _ANALOGDC
+
+#include <Streaming.h>
+#include "console.h"
+
+//! Analog input pin of the duty cycle pot
+#define ANALOG_DC_PIN A0
+//! Analog converter resolution (bits)
+#define ANALOG_DC_BITS 10
+//! Time between two conversions (ms)
+#define ANALOG_SAMPLE_MS 2
+//! Number of conversions averaged in a single sample, power of 2
+#define ANALOG_OVERSAMPLE_SHIFT 2
+#define ANALOG_OVERSAMPLE (1 << ANALOG_OVERSAMPLE_SHIFT)
+//! Low pass filter coefficient, every sample moves the output by 1/2^n of the difference
+#define ANALOG_FILTER_SHIFT 2
+//! Min change of the duty cycle (0-255) accepted as a new value
+#define ANALOG_HYSTERESIS 3
+
+#define ADC_MSG_TITLE "Analog DC"
+#define ADC_MSG_RAW " raw "
+#define ADC_MSG_FILTERED " filtered "
+#define ADC_MSG_VALUE " dc "
+
+/**
+ * \brief Background sampler of the duty cycle pot
+ */
+class AnalogDC {
+  public:
+
+    //! Duty cycle (0-255) after the filter and the hysteresis
+    uint8_t value = 0;
+    //! Last averaged sample, converter units
+    uint16_t raw = 0;
+
+    /**
+     * \brief Start a new conversion if the sampling time is expired
+     *
+     * Only one conversion is executed every call so the main loop is never
+     * held for more than the conversion time.
+     *
+     * \return true if the duty cycle value has changed
+     */
+    boolean sample(void);
+
+    //! \brief Show the sampler status
+    void showInfo(void);
+
+  private:
+    //! Time of the last conversion (millis)
+    unsigned long lastSample = 0;
+    //! Sum of the conversions of the current sample
+    uint16_t accumulator = 0;
+    //! Conversions accumulated so far
+    uint8_t count = 0;
+    //! Filter output, converter units scaled by 2^ANALOG_FILTER_SHIFT
+    uint16_t filtered = 0;
+    //! The filter is initialised by the first sample
+    boolean primed = false;
+};
+
+#endif
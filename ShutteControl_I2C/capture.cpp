@@ -0,0 +1,191 @@
+/**
+ *  \file capture.cpp
+ *  \brief This file defines functions and predefined instances from capture.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "capture.h"
+
+Capture capture;
+
+//! Check if a record type is a command
+#define isCommand(x) (((x) == CAP_CMD_SERIAL) || ((x) == CAP_CMD_I2C))
+
+boolean Capture::start(MotorControl &motor) {
+  if(state == CAP_REPLAYING)
+    return false;
+
+  used = 0;
+  lastTime = 0;
+  events = 0;
+  lost = 0;
+  motor.getProfile(initial);
+  startTime = micros();
+  state = CAP_RECORDING;
+
+  return true;
+}
+
+void Capture::stop(void) {
+  if(state == CAP_RECORDING)
+    state = CAP_IDLE;
+}
+
+void Capture::command(uint8_t source, const String &cmd) {
+  if(state != CAP_RECORDING)
+    return;
+
+  append(source, (const uint8_t*)cmd.c_str(), (uint8_t)min(cmd.length(), 255U));
+}
+
+void Capture::trace(uint8_t type, const uint8_t* data, uint8_t len) {
+  unsigned long expected, t;
+
+  if(state == CAP_RECORDING) {
+    append(type, data, len);
+    return;
+  }
+
+  // Replaying: compare with the next trace event of the log
+  t = now();
+  if( (traceCursor >= used) || (buffer[traceCursor + 4] != type) ||
+      (buffer[traceCursor + 5] != len) ||
+      (memcmp(&buffer[traceCursor + CAP_HEADER_SIZE], data, len) != 0) ) {
+    if(firstMismatch < 0)
+      firstMismatch = traceCursor;
+    mismatches++;
+  }
+  else {
+    expected = recordTime(traceCursor);
+    t = (t > expected) ? (t - expected) : (expected - t);
+    if(t > maxDrift)
+      maxDrift = t;
+  }
+
+  if(traceCursor < used)
+    traceCursor = findNext(traceCursor + CAP_HEADER_SIZE + buffer[traceCursor + 5], false);
+}
+
+void Capture::append(uint8_t type, const uint8_t* data, uint8_t len) {
+  unsigned long t;
+  int j;
+
+  if(used + CAP_HEADER_SIZE + len > CAP_BUFFER_SIZE) {
+    lost++;
+    return;
+  }
+
+  t = now();
+  for(j = 0; j < 4; j++)
+    buffer[used + j] = (uint8_t)(t >> (8 * j));
+  buffer[used + 4] = type;
+  buffer[used + 5] = len;
+  memcpy(&buffer[used + CAP_HEADER_SIZE], data, len);
+
+  used += CAP_HEADER_SIZE + len;
+  events++;
+  lastTime = t;
+}
+
+boolean Capture::beginReplay(MotorControl &motor) {
+  if( (state != CAP_IDLE) || (used == 0) )
+    return false;
+
+  // Initial conditions of the capture, not traced
+  motor.setProfile(initial);
+  motor.apply();
+
+  mismatches = 0;
+  firstMismatch = -1;
+  maxDrift = 0;
+  cmdCursor = findNext(0, true);
+  traceCursor = findNext(0, false);
+  startTime = micros();
+  state = CAP_REPLAYING;
+
+  return true;
+}
+
+boolean Capture::nextCommand(unsigned long &time, String &cmd) {
+  int j;
+
+  if(cmdCursor >= used)
+    return false;
+
+  time = recordTime(cmdCursor);
+  cmd = "";
+  for(j = 0; j < buffer[cmdCursor + 5]; j++)
+    cmd += (char)buffer[cmdCursor + CAP_HEADER_SIZE + j];
+
+  cmdCursor = findNext(cmdCursor + CAP_HEADER_SIZE + buffer[cmdCursor + 5], true);
+
+  return true;
+}
+
+void Capture::endReplay(void) {
+  // The events of the log not produced by the replay
+  while(traceCursor < used) {
+    if(firstMismatch < 0)
+      firstMismatch = traceCursor;
+    mismatches++;
+    traceCursor = findNext(traceCursor + CAP_HEADER_SIZE + buffer[traceCursor + 5], false);
+  }
+
+  state = CAP_IDLE;
+}
+
+uint16_t Capture::findNext(uint16_t cursor, boolean commands) {
+  while( (cursor < used) && (isCommand(buffer[cursor + 4]) != commands) )
+    cursor += CAP_HEADER_SIZE + buffer[cursor + 5];
+
+  return (cursor < used) ? cursor : used;
+}
+
+unsigned long Capture::recordTime(uint16_t offset) {
+  unsigned long t;
+  int j;
+
+  t = 0;
+  for(j = 3; j >= 0; j--)
+    t = (t << 8) | buffer[offset + j];
+
+  return t;
+}
+
+void Capture::dump(void) {
+  int j;
+  Print &out = console.bulk();
+
+  for(j = 0; j < used; j++) {
+    if((j % CAP_DUMP_LINE) == 0)
+      out << CAP_MSG_DUMP;
+    if(buffer[j] < 0x10)
+      out << "0";
+    out << _HEX(buffer[j]);
+    if( ((j % CAP_DUMP_LINE) == (CAP_DUMP_LINE - 1)) || (j == used - 1) )
+      out << endl;
+  }
+}
+
+void Capture::showInfo(void) {
+  if(!LOG_ENABLED(LOG_INFO))
+    return;
+  Print &out = console;
+
+  out << CAP_MSG_TITLE;
+  switch(state) {
+    case CAP_IDLE:
+      out << CAP_MSG_IDLE;
+    break;
+    case CAP_RECORDING:
+      out << CAP_MSG_RECORDING;
+    break;
+    case CAP_REPLAYING:
+      out << CAP_MSG_REPLAYING;
+    break;
+  }
+  out << CAP_MSG_BYTES << used << CAP_MSG_EVENTS << events << CAP_MSG_LOST << lost << endl;
+  out << CAP_MSG_TITLE << CAP_MSG_MISMATCH << mismatches << CAP_MSG_FIRST << firstMismatch <<
+    CAP_MSG_DRIFT << maxDrift << endl;
+}
@@ -0,0 +1,205 @@
+/**
+ *  \file capture.h
+ *  \brief Capture of the commands and of the hardware activity, with replay
+ *
+ *  While recording, every command received is saved with its source and
+ *  arrival time, together with the trace of the TLE94112 writes and of the
+ *  shutter pins edges, in a compact binary log that can be dumped.
+ *
+ *  The replay executes again the captured commands with the same timing
+ *  relative to the replay start, after restoring the motor settings of
+ *  the capture start. The new TLE94112 writes and pin edges are compared
+ *  on the fly with the captured trace: the differences and the max timing
+ *  drift of the events are reported.
+ *
+ *  Log record: time (us from the capture start, 4 bytes little endian),
+ *  type (1 byte), payload length (1 byte), payload.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _CAPTURE
+#define _CAPTURE
+
+#include <Streaming.h>
+#include "motorcontrol.h"
+#include "console.h"
+
+#define CAP_BUFFER_SIZE 1024  ///< Size of the capture log
+#define CAP_HEADER_SIZE 6     ///< Size of the record header
+#define CAP_DUMP_LINE 32      ///< Bytes every line of the log dump
+
+#define CAP_IDLE 0        ///< Not capturing
+#define CAP_RECORDING 1   ///< Recording the commands and the trace
+#define CAP_REPLAYING 2   ///< Replaying, the trace is compared with the log
+
+// Record types
+#define CAP_CMD_SERIAL 1  ///< Command from the serial, payload the command string
+#define CAP_CMD_I2C 2     ///< Command from the I2C, payload the command string
+#define CAP_TLE_HB 3      ///< Half bridge write, payload half bridge, state, PWM channel, freewheeling
+#define CAP_TLE_PWM 4     ///< PWM channel write, payload channel, frequency, duty cycle
+#define CAP_PIN 5         ///< Pin edge, payload pin, level
+
+//! Freewheeling value of the half bridge writes without the freewheeling parameter
+#define CAP_FW_DEFAULT 0xFF
+
+#define CAP_MSG_TITLE "Capture "
+#define CAP_MSG_IDLE "idle"
+#define CAP_MSG_RECORDING "recording"
+#define CAP_MSG_REPLAYING "replaying"
+#define CAP_MSG_BYTES " bytes "
+#define CAP_MSG_EVENTS " events "
+#define CAP_MSG_LOST " lost "
+#define CAP_MSG_MISMATCH " replay mismatches "
+#define CAP_MSG_FIRST " first at "
+#define CAP_MSG_DRIFT " max drift (us) "
+#define CAP_MSG_DUMP "CAP "
+
+/**
+ * \brief Commands capture, hardware trace and replay
+ */
+class Capture {
+  public:
+
+    //! Current state: idle, recording or replaying
+    uint8_t state = CAP_IDLE;
+    //! Bytes used in the log
+    uint16_t used = 0;
+    //! Number of records in the log
+    unsigned int events = 0;
+    //! Number of records not saved because the log was full
+    unsigned int lost = 0;
+    //! Trace events of the last replay different from the log, or missing
+    unsigned int mismatches = 0;
+    //! Log offset of the first mismatch of the last replay
+    int firstMismatch = -1;
+    //! Max difference (us) between the captured and the replayed events time
+    unsigned long maxDrift = 0;
+    //! Time (us from the capture start) of the last record
+    unsigned long lastTime = 0;
+
+    /**
+     * \brief Clear the log and start recording. The current motor settings
+     * are saved to restore them before the replay
+     *
+     * \param motor The motor control
+     * \return false if a replay is running
+     */
+    boolean start(MotorControl &motor);
+
+    //! \brief Stop recording
+    void stop(void);
+
+    /**
+     * \brief Record a received command
+     *
+     * \param source CAP_CMD_SERIAL or CAP_CMD_I2C
+     * \param cmd The command line or frame
+     */
+    void command(uint8_t source, const String &cmd);
+
+    //! \brief Trace a half bridge write
+    inline void tleHB(uint8_t hb, uint8_t st, uint8_t pwm, uint8_t fw) {
+      if(state != CAP_IDLE) {
+        uint8_t data[4] = { hb, st, pwm, fw };
+        trace(CAP_TLE_HB, data, sizeof(data));
+      }
+    }
+
+    //! \brief Trace a PWM channel write
+    inline void tlePWM(uint8_t ch, uint8_t freq, uint8_t dc) {
+      if(state != CAP_IDLE) {
+        uint8_t data[3] = { ch, freq, dc };
+        trace(CAP_TLE_PWM, data, sizeof(data));
+      }
+    }
+
+    //! \brief Trace a pin edge
+    inline void pin(uint8_t p, uint8_t level) {
+      if(state != CAP_IDLE) {
+        uint8_t data[2] = { p, level };
+        trace(CAP_PIN, data, sizeof(data));
+      }
+    }
+
+    /**
+     * \brief Start the replay of the log. The motor settings saved on the
+     * capture start are applied before the trace comparison starts
+     *
+     * \param motor The motor control
+     * \return false if the log is empty
+     */
+    boolean beginReplay(MotorControl &motor);
+
+    /**
+     * \brief Get the next command to replay
+     *
+     * \param time The command time (us from the replay start)
+     * \param cmd The command
+     * \return false if there are no more commands
+     */
+    boolean nextCommand(unsigned long &time, String &cmd);
+
+    /**
+     * \brief Time (us) elapsed from the capture or replay start
+     */
+    unsigned long now(void) {
+      return micros() - startTime;
+    }
+
+    //! \brief End the replay, the trace events not replayed are counted as mismatches
+    void endReplay(void);
+
+    //! \brief Dump the log in hex format
+    void dump(void);
+
+    //! \brief Show the capture status and the last replay result
+    void showInfo(void);
+
+  private:
+    //! Log
+    uint8_t buffer[CAP_BUFFER_SIZE];
+    //! Capture or replay start time (micros)
+    unsigned long startTime;
+    //! Next command to replay
+    uint16_t cmdCursor;
+    //! Next trace event expected while replaying
+    uint16_t traceCursor;
+    //! Motor settings on the capture start
+    motorProfile initial;
+
+    /**
+     * \brief Record a trace event or compare it with the log while replaying
+     *
+     * \param type The record type
+     * \param data The payload
+     * \param len The payload length
+     */
+    void trace(uint8_t type, const uint8_t* data, uint8_t len);
+
+    /**
+     * \brief Append a record to the log
+     *
+     * \param type The record type
+     * \param data The payload
+     * \param len The payload length
+     */
+    void append(uint8_t type, const uint8_t* data, uint8_t len);
+
+    /**
+     * \brief Find the next record of the selected kind
+     *
+     * \param cursor The log offset to start from
+     * \param commands true for the commands, false for the trace events
+     * \return The log offset of the record or used if not found
+     */
+    uint16_t findNext(uint16_t cursor, boolean commands);
+
+    //! \brief Time of the record at the offset
+    unsigned long recordTime(uint16_t offset);
+};
+
+//! Capture instance
+extern Capture capture;
+
+#endif
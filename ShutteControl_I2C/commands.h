@@ -32,10 +32,31 @@
 #define CMD_DIRECTION "Direction "
 #define CMD_PWM "PWM: "
 #define CMD_WRONGCMD "wrong command "
+#define CMD_TRIGGER "trigger "
+#define CMD_ARMED "armed "
+#define CMD_DISARMED "disarmed"
+#define CMD_NOTARMED "not armed"
+#define CMD_STATUS "status"
+#define CMD_BUSY "busy"
+#define CMD_TOOLONG "line too long"
+
+#define CMD_LINE_MAX 128      ///< Max length of a serial command line, ended by CR or LF
+#define I2C_FRAME_MAX 32      ///< Max length of an I2C frame (Wire buffer size)
+#define I2C_STATUS_MAX 32     ///< Max length of the I2C status register
+
+#define CMD_SEP ';'           ///< Separator of multiple commands in the same line or I2C frame
+#define CMD_STATUS_OK '+'     ///< Command status: executed
+#define CMD_STATUS_FAIL '-'   ///< Command status: unknown or failed
+
+#define CMD_SEQ_PREFIX '#'      ///< Start of the sequence ID of a tagged command
+#define CMD_SEQ_END ':'         ///< End of the sequence ID of a tagged command
+#define CMD_ACK_ACCEPTED 'A'    ///< Acknowledge: the command has been accepted
+#define CMD_ACK_COMPLETED 'C'   ///< Acknowledge: the command has been completed
+#define CMD_ACK_FAILED 'F'      ///< Acknowledge: the command is unknown or failed
 
 // Duty cycle settings to PWM channels
-#define MANUAL_DC "dcmanual"    ///< Set the duty cycle value depending on the pot
-#define INFO_DC "dcinfo"        ///< Set the current duty cycle values
+#define MANUAL_DC "dcmanual"    ///< Set the duty cycle value depending on the pot, followed by channel (1-3, 0 = all),mode (1 = manual, 0 = auto)
+#define INFO_DC "dcinfo"        ///< Show the current duty cycle values
 
 // Configuration command
 #define SHOW_CONF "conf"    ///< Dump the current settings
@@ -47,6 +68,11 @@
 #define SH_TOP_UNLOCK "shTopunlock"     ///< Unlock the top shutter frame
 #define SH_BOTTOM_LOCK "shBottomlock"       ///< Lock the bottom shutter frame
 #define SH_BOTTOM_UNLOCK "shBottomunlock"   ///< Unlock the bottom shutter frame
+#define SH_ARM "shArm"      ///< Load the shutter and lock the bottom frame ready to fire
+#define SH_FIRE "shFire"    ///< Fire the armed shutter, followed by the exposure (ms)
+#define SH_RELEASE "shRelease"  ///< Set the delay between the bottom release and the top opening, followed by the delay (us)
+#define SH_CYCLE_INFO "shCycleInfo"   ///< Show the shutter motor cycles statistics
+#define SH_CYCLE_RESET "shCycleReset" ///< Reset the shutter motor cycles statistics
 
 // Shooting
 #define SHOT_8S "8s"      ///< 8000 ms = 8 sec
@@ -71,6 +97,154 @@
 
 #define MULTI_SHOOTING 10   ///< Number of multiple shots in sequence
 
+// Timelapse (all prefixed with 'tl')
+#define TL_START "tlStart"    ///< Start a timelapse, followed by interval,count,exposure (ms,n,ms)
+#define TL_PAUSE "tlPause"    ///< Pause the running timelapse
+#define TL_RESUME "tlResume"  ///< Resume the paused timelapse
+#define TL_STOP "tlStop"      ///< Cancel the timelapse
+#define TL_INFO "tlInfo"      ///< Show the timelapse progress
+
+// External trigger (all prefixed with 'trg')
+#define TRG_ARM "trgArm"        ///< Arm the trigger input, followed by the exposure (ms)
+#define TRG_DISARM "trgDisarm"  ///< Disarm the trigger input
+#define TRG_FIRE "trgFire"      ///< Pulse the trigger output and shoot the armed exposure
+
+// Motors configuration (all prefixed with 'mot')
+#define MOTOR_STAGGER "motStagger"  ///< Set the staggered start, followed by delay (us),current budget
+#define MOTOR_STOP_MODE "motStop"   ///< Set the stop mode, followed by motor (1-6, 0 = all),mode (0 = coast, 1 = brake, 2 = timed brake),brake time (ms)
+#define MOTOR_PWM "motPWM"          ///< Request a PWM channel, followed by motor (1-6),frequency (Hz, 0 = no PWM),duty cycle
+#define MOTOR_MOVE "motMove"        ///< Run a motor then stop it, followed by motor (2-6),direction (1 = CW, 2 = CCW),time (ms)
+
+// PWM channels (all prefixed with 'pwm')
+#define PWM_FREQ "pwmFreq"    ///< Bind a frequency to a channel, followed by channel (1-3, 0 = all),frequency (Hz)
+
+// Configuration profiles (all prefixed with 'prof')
+#define PROF_SAVE "profSave"  ///< Save the motors and PWM settings, followed by the profile (1-3)
+#define PROF_LOAD "profLoad"  ///< Apply a saved profile, followed by the profile (1-3)
+#define PROF_BOOT "profBoot"  ///< Select the profile applied on boot, followed by the profile (0 = defaults)
+#define PROF_INFO "profInfo"  ///< Show the saved profiles and the boot time
+
+// Low power mode (all prefixed with 'idle')
+#define IDLE_TIMEOUT "idleTimeout"  ///< Set the idle timeout, followed by the time (ms, 0 = never sleep)
+#define IDLE_INFO "idleInfo"        ///< Show the idle timeout and the wake up statistics
+
+// Thermal governor (all prefixed with 'th')
+#define TH_INFO "thInfo"    ///< Show the throttling level, the temperature events and the motors running time
+
+// Scheduler (all prefixed with 'sch')
+#define SCH_INFO "schInfo"    ///< Show the main loop tasks statistics
+#define SCH_RESET "schReset"  ///< Reset the main loop tasks statistics
+
+// Capture and replay (all prefixed with 'cap')
+#define CAP_START "capStart"    ///< Clear the log and start capturing the commands and the hardware trace
+#define CAP_STOP "capStop"      ///< Stop capturing
+#define CAP_DUMP "capDump"      ///< Dump the log in hex format
+#define CAP_REPLAY "capReplay"  ///< Replay the captured commands and compare the hardware trace
+#define CAP_INFO "capInfo"      ///< Show the capture status and the last replay result
+
+// Runtime statistics
+#define STATS_SHOW "stats"          ///< Show the commands, SPI, faults and main loop statistics
+#define STATS_RESET "statsReset"    ///< Reset the runtime statistics
+
+// Console (all prefixed with 'log')
+#define LOG_SET_LEVEL "logLevel"  ///< Set the runtime log level, followed by the level (0-4)
+#define LOG_SHOW_INFO "logInfo"   ///< Show the log level and the dropped output bytes
+
+// Macros (all prefixed with 'mc'). The macro commands can't be recorded
+#define MC_REC "mcRec"    ///< Start recording a macro, followed by the name
+#define MC_END "mcEnd"    ///< End the recording and save the macro
+#define MC_RUN "mcRun"    ///< Run a macro, followed by the name
+#define MC_DEL "mcDel"    ///< Delete a macro, followed by the name
+#define MC_LIST "mcList"  ///< List the stored macros
+
+// Serial link (all prefixed with 'ser')
+#define SER_BAUD "serBaud"  ///< Change the framed serial speed, followed by the speed (38400-460800 bps)
+#define SER_INFO "serInfo"  ///< Show the serial speed and the framed link statistics
+
+// =========================================================
+// Command dispatch
+// =========================================================
+
+#define CMD_MAX_PARAMS 3    ///< Max number of numeric parameters of a command
+#define CMD_PARAM_SEP ','   ///< Parameters separator
+
+// Command IDs used by the dispatcher and stored in the macros.
+// Don't change the existing values or the stored macros become invalid
+#define CID_NONE 0
+#define CID_CONF 1
+#define CID_SH_INIT 2
+#define CID_SH_CYCLE 3
+#define CID_SH_ARM 4
+#define CID_SH_FIRE 5
+#define CID_SH_TOPLOCK 6
+#define CID_SH_TOPUNLOCK 7
+#define CID_SH_BOTTOMLOCK 8
+#define CID_SH_BOTTOMUNLOCK 9
+#define CID_SHOT 10
+#define CID_MULTISHOT 11
+#define CID_TL_START 12
+#define CID_TL_PAUSE 13
+#define CID_TL_RESUME 14
+#define CID_TL_STOP 15
+#define CID_TL_INFO 16
+#define CID_TRG_ARM 17
+#define CID_TRG_DISARM 18
+#define CID_TRG_FIRE 19
+#define CID_LOG_LEVEL 20
+#define CID_LOG_INFO 21
+// 22 is not used, the current class is fixed by the wiring (MOTOR_CURRENT_WIRING)
+#define CID_MOTOR_PWM 23
+#define CID_PWM_FREQ 24
+#define CID_MANUAL_DC 25
+#define CID_INFO_DC 26
+#define CID_IDLE_TIMEOUT 27
+#define CID_IDLE_INFO 28
+#define CID_PROF_SAVE 29
+#define CID_PROF_LOAD 30
+#define CID_PROF_BOOT 31
+#define CID_PROF_INFO 32
+#define CID_TH_INFO 33
+#define CID_MOTOR_STAGGER 34
+#define CID_SH_RELEASE 35
+#define CID_SCH_INFO 36
+#define CID_SCH_RESET 37
+#define CID_CAP_START 38
+#define CID_CAP_STOP 39
+#define CID_CAP_DUMP 40
+#define CID_CAP_REPLAY 41
+#define CID_CAP_INFO 42
+#define CID_STATS_SHOW 43
+#define CID_STATS_RESET 44
+#define CID_MOTOR_STOP_MODE 45
+#define CID_SH_CYCLE_INFO 46
+#define CID_SH_CYCLE_RESET 47
+#define CID_MOTOR_MOVE 48
+#define CID_SER_BAUD 49
+#define CID_SER_INFO 50
+
+#define CID_NUM 51  ///< Number of command IDs, new IDs should be added before
+
+/**
+ * Command table entry. Commands without parameters should match
+ * the name exactly, else the name is the prefix of the parameters list
+ */
+struct commandDef {
+  const char* name;     ///< Command string
+  uint8_t id;           ///< Command ID
+  long value;           ///< Fixed value (e.g. the exposure of the shooting commands)
+  uint8_t numParams;    ///< Number of numeric parameters following the name
+};
+
+/**
+ * Decoded command ready to be executed, without further string parsing
+ */
+struct dispatchEntry {
+  uint8_t id;                       ///< Command ID
+  uint8_t numParams;                ///< Number of parameters
+  long value;                       ///< Fixed value from the command table
+  long params[CMD_MAX_PARAMS];      ///< Parameters values
+};
+
 /* ***********************************************************
 #define MOTOR_START "start"   ///< start all
 #define MOTOR_STOP "stop"     ///< stop all
@@ -0,0 +1,55 @@
+/**
+ *  \file console.cpp
+ *  \brief This file defines functions and predefined instances from console.h
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "console.h"
+
+Console console;
+
+size_t Console::write(uint8_t c) {
+  uint16_t next;
+
+  next = (head + 1) % TX_BUFFER_SIZE;
+  if(next == tail) {
+    dropped++;
+    return 0;
+  }
+
+  buffer[head] = c;
+  head = next;
+
+  return 1;
+}
+
+void Console::drain(void) {
+  int j, room;
+
+  // Never more than the serial can take without blocking
+  room = Serial.availableForWrite();
+  if(room > TX_DRAIN_CHUNK)
+    room = TX_DRAIN_CHUNK;
+
+  for(j = 0; (j < room) && (tail != head); j++) {
+    Serial.write(buffer[tail]);
+    tail = (tail + 1) % TX_BUFFER_SIZE;
+  }
+}
+
+void Console::flush(void) {
+  while(tail != head) {
+    Serial.write(buffer[tail]);
+    tail = (tail + 1) % TX_BUFFER_SIZE;
+  }
+}
+
+Print &Console::bulk(void) {
+  flush();
+  return Serial;
+}
+
+void Console::showInfo(void) {
+  *this << LOG_MSG_LEVEL << level << LOG_MSG_DROPPED << dropped << endl;
+}
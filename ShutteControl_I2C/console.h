@@ -0,0 +1,99 @@
+/**
+ *  \file console.h
+ *  \brief Buffered serial console with log levels
+ *  
+ *  The messages are queued in a ring buffer and sent to the serial by
+ *  the main loop a few bytes at a time, so printing never blocks the
+ *  shutter timing. When the buffer is full the new bytes are dropped
+ *  and counted.
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _CONSOLE
+#define _CONSOLE
+
+#include <Streaming.h>
+
+#define LOG_NONE 0      ///< No messages
+#define LOG_ERROR 1     ///< Errors
+#define LOG_WARNING 2   ///< Warnings
+#define LOG_INFO 3      ///< Command messages
+#define LOG_DEBUG 4     ///< Debug and timing messages
+
+//! Messages above this level are removed at compile time
+#define LOG_COMPILE_LEVEL LOG_INFO
+//! Default runtime log level
+#define LOG_LEVEL_DEFAULT LOG_INFO
+
+#define TX_BUFFER_SIZE 512  ///< Size of the transmission ring buffer
+#define TX_DRAIN_CHUNK 16   ///< Max bytes sent to the serial every drain call
+
+#define LOG_MSG_LEVEL "Log level "
+#define LOG_MSG_DROPPED " dropped "
+
+//! Check if the messages of a level are shown. The check is a constant false
+//! above LOG_COMPILE_LEVEL so the code of the filtered messages is removed
+#define LOG_ENABLED(lvl) ( ((lvl) <= LOG_COMPILE_LEVEL) && ((lvl) <= console.level) )
+
+//! Output of a message: CONSOLE_LOG(LOG_INFO) << "text" << value << endl;
+//! The statement runs once if the level is shown, so the arguments are not
+//! evaluated when the message is filtered
+#define CONSOLE_LOG(lvl) for(boolean logShown = LOG_ENABLED(lvl); logShown; logShown = false) console
+
+/**
+ * \brief Serial transmission ring buffer with log levels
+ */
+class Console : public Print {
+  public:
+
+    //! Runtime log level, messages above this level are discarded
+    uint8_t level = LOG_LEVEL_DEFAULT;
+    //! Number of bytes lost because the buffer was full
+    unsigned long dropped = 0;
+
+    /**
+     * \brief Queue a character. If the buffer is full the character is dropped
+     * 
+     * \param c The character
+     * \return 1 if the character has been queued
+     */
+    size_t write(uint8_t c);
+    using Print::write;
+
+    /**
+     * \brief Send the queued characters to the serial, up to TX_DRAIN_CHUNK
+     * and to the room left in the serial transmission buffer, so it never
+     * blocks. Should be called by the main loop
+     */
+    void drain(void);
+
+    /**
+     * \brief Send all the queued characters to the serial (blocking)
+     */
+    void flush(void);
+
+    /**
+     * \brief Output for the large informative dumps explicitly requested by the user.
+     * The buffer is flushed then the serial is returned, to preserve the messages order.
+     * 
+     * \return The serial
+     */
+    Print &bulk(void);
+
+    //! \brief Show the log level and the dropped bytes
+    void showInfo(void);
+
+  private:
+    //! Ring buffer
+    uint8_t buffer[TX_BUFFER_SIZE];
+    //! Next position to write
+    uint16_t head = 0;
+    //! Next position to send
+    uint16_t tail = 0;
+};
+
+//! Serial console instance
+extern Console console;
+
+#endif
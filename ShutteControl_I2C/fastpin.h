@@ -0,0 +1,132 @@
+/**
+ *  \file fastpin.h
+ *  \brief Direct port access for the shutter solenoids and the timing pins
+ *
+ *  digitalWrite() looks up the pin tables on every call. The port register
+ *  and the bit mask of every pin are resolved once when the pin is
+ *  initialised, then a write is a single register store. Two pins on the
+ *  same port can be changed together with a single atomic write.
+ *
+ *  On the XMC the port Output Modification Register sets and resets the
+ *  bits in a single write without read-modify-write; on the AVR the port
+ *  register is updated with the interrupts disabled. On the other
+ *  architectures digitalWrite() is used.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _FASTPIN
+#define _FASTPIN
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_XMC) || defined(XMC1100_Series)
+#define _FASTPIN_XMC
+#elif defined(__AVR__)
+#define _FASTPIN_AVR
+#endif
+
+/**
+ * \brief Output pin with the port register resolved on initialisation
+ */
+class FastPin {
+  public:
+
+    /**
+     * \brief Set the pin as output and resolve its port register
+     *
+     * \param p The Arduino pin number
+     */
+    void begin(uint8_t p) {
+      pin = p;
+      pinMode(pin, OUTPUT);
+#if defined(_FASTPIN_XMC)
+      port = mapping_port_pin[pin].port;
+      mask = 1UL << mapping_port_pin[pin].pin;
+#elif defined(_FASTPIN_AVR)
+      port = portOutputRegister(digitalPinToPort(pin));
+      mask = digitalPinToBitMask(pin);
+#endif
+    }
+
+    //! \brief Set the pin high
+    inline void set(void) {
+#if defined(_FASTPIN_XMC)
+      port->OMR = mask;
+#elif defined(_FASTPIN_AVR)
+      uint8_t s = SREG;
+      cli();
+      *port |= mask;
+      SREG = s;
+#else
+      digitalWrite(pin, 1);
+#endif
+    }
+
+    //! \brief Set the pin low
+    inline void clear(void) {
+#if defined(_FASTPIN_XMC)
+      port->OMR = mask << 16;
+#elif defined(_FASTPIN_AVR)
+      uint8_t s = SREG;
+      cli();
+      *port &= ~mask;
+      SREG = s;
+#else
+      digitalWrite(pin, 0);
+#endif
+    }
+
+    //! \brief Write the pin level
+    inline void write(boolean v) {
+      if(v)
+        set();
+      else
+        clear();
+    }
+
+    /**
+     * \brief Write two pins together. If the pins are on the same port
+     * both the edges happen in the same register write
+     *
+     * \param a The first pin
+     * \param va The level of the first pin
+     * \param b The second pin
+     * \param vb The level of the second pin
+     */
+    static inline void write(FastPin &a, boolean va, FastPin &b, boolean vb) {
+#if defined(_FASTPIN_XMC)
+      if(a.port == b.port) {
+        a.port->OMR = (va ? a.mask : (a.mask << 16)) | (vb ? b.mask : (b.mask << 16));
+        return;
+      }
+#elif defined(_FASTPIN_AVR)
+      if(a.port == b.port) {
+        uint8_t s = SREG;
+        cli();
+        *a.port = (*a.port & ~(a.mask | b.mask)) | (va ? a.mask : 0) | (vb ? b.mask : 0);
+        SREG = s;
+        return;
+      }
+#endif
+      a.write(va);
+      b.write(vb);
+    }
+
+  private:
+    //! Arduino pin number
+    uint8_t pin;
+#if defined(_FASTPIN_XMC)
+    //! Port registers
+    XMC_GPIO_PORT_t *port;
+    //! Pin bit
+    uint32_t mask;
+#elif defined(_FASTPIN_AVR)
+    //! Port output register
+    volatile uint8_t *port;
+    //! Pin bit
+    uint8_t mask;
+#endif
+};
+
+#endif
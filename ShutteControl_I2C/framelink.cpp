@@ -0,0 +1,155 @@
+/**
+ *  \file framelink.cpp
+ *  \brief This file defines functions and predefined instances from framelink.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "framelink.h"
+
+FrameLink frameLink;
+
+//! Speeds accepted by the baud command
+const unsigned long baudRates[FRAME_BAUD_RATES] = {
+  38400UL, 57600UL, 115200UL, 230400UL, 460800UL
+};
+
+boolean FrameLink::receive(void) {
+  uint8_t c;
+
+  while(Serial.available() > 0) {
+    c = Serial.read();
+    lastByte = millis();
+
+    switch(state) {
+      case FRAME_HUNT:
+        if(c == FRAME_STX) {
+          crc = CRC16_INIT;
+          state = FRAME_LENGTH;
+        }
+      break;
+      case FRAME_LENGTH:
+        length = c;
+        crc = crc16(&c, 1, crc);
+        state = (length > FRAME_PAYLOAD_MAX) ? FRAME_HUNT : FRAME_SEQ;
+        if(state == FRAME_HUNT)
+          crcErrors++;
+      break;
+      case FRAME_SEQ:
+        seq = c;
+        crc = crc16(&c, 1, crc);
+        count = 0;
+        state = (length == 0) ? FRAME_CRC_HI : FRAME_PAYLOAD;
+      break;
+      case FRAME_PAYLOAD:
+        buffer[count++] = c;
+        crc = crc16(&c, 1, crc);
+        if(count == length)
+          state = FRAME_CRC_HI;
+      break;
+      case FRAME_CRC_HI:
+        frameCrc = c << 8;
+        state = FRAME_CRC_LO;
+      break;
+      case FRAME_CRC_LO:
+        frameCrc |= c;
+        state = FRAME_HUNT;
+
+        if(frameCrc != crc) {
+          crcErrors++;
+          reply(FRAME_NAK, seq);
+          break;
+        }
+
+        // A valid frame confirms the new speed
+        baudTime = 0;
+        reply(FRAME_ACK, seq);
+
+        // Empty frame: the master restarts the sequence
+        if(length == 0) {
+          lastSeq = -1;
+          break;
+        }
+        // The acknowledge was lost and the master sent the frame again
+        if(seq == lastSeq) {
+          duplicates++;
+          break;
+        }
+
+        lastSeq = seq;
+        buffer[length] = 0;
+        frames++;
+        return true;
+    }
+  }
+
+  return false;
+}
+
+void FrameLink::poll(void) {
+  // The bytes waiting in the RX buffer arrived in time while the main
+  // loop was busy, the frame expires only when there is nothing to read
+  if(Serial.available() == 0)
+    expire();
+
+  // The master can't talk at the new speed
+  if( (baudTime != 0) && ((millis() - baudTime) > FRAME_BAUD_CONFIRM_MS) ) {
+    reverted++;
+    baudTime = 0;
+    baud = oldBaud;
+    Serial.end();
+    Serial.begin(baud);
+  }
+}
+
+boolean FrameLink::setBaud(long rate) {
+  int j;
+
+  for(j = 0; j < FRAME_BAUD_RATES; j++) {
+    if(baudRates[j] == (unsigned long)rate) {
+      newBaud = rate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void FrameLink::applyBaud(void) {
+  if(newBaud == 0)
+    return;
+
+  // The acknowledge of the command is sent at the old speed
+  console.flush();
+  Serial.flush();
+  Serial.end();
+  Serial.begin(newBaud);
+
+  oldBaud = baud;
+  baud = newBaud;
+  newBaud = 0;
+  state = FRAME_HUNT;
+  baudTime = millis();
+  if(baudTime == 0)
+    baudTime = 1;
+}
+
+void FrameLink::showInfo(void) {
+  CONSOLE_LOG(LOG_INFO) << FRAME_MSG_TITLE << baud << FRAME_MSG_FRAMES << frames << FRAME_MSG_CRC << crcErrors <<
+    FRAME_MSG_TIMEOUTS << timeouts << FRAME_MSG_DUPLICATES << duplicates << FRAME_MSG_REVERTED << reverted << endl;
+}
+
+void FrameLink::expire(void) {
+  // The rest of the frame has been lost, the master will send it again
+  if( (state != FRAME_HUNT) && ((millis() - lastByte) > FRAME_BYTE_MS) ) {
+    timeouts++;
+    if(state > FRAME_SEQ)
+      reply(FRAME_NAK, seq);
+    state = FRAME_HUNT;
+  }
+}
+
+void FrameLink::reply(uint8_t code, uint8_t s) {
+  Serial.write(code);
+  Serial.write(s);
+}
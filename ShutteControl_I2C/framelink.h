@@ -0,0 +1,158 @@
+/**
+ *  \file framelink.h
+ *  \brief Framed serial link with CRC, acknowledge and retransmit
+ *
+ *  With the framed link every command is checked by a CRC and sent again
+ *  by the master when it is lost. Every frame from the master is:
+ *
+ *      STX, length, sequence, payload (length bytes), CRC-16 (MSB first)
+ *
+ *  The CRC-16/CCITT (polynomial 0x1021, init 0xFFFF) covers length,
+ *  sequence and payload. The payload is a command string as sent on the
+ *  unframed serial. The frames are read only between the commands, so a
+ *  whole frame must fit the serial RX buffer of the core.
+ *
+ *  Every frame is answered as soon as it is received, before executing
+ *  it, with two bytes: FRAME_ACK or FRAME_NAK followed by the sequence.
+ *  The bytes can be mixed with the console messages, that never contain
+ *  them. The master sends one frame at a time and sends it again on NAK
+ *  or when the acknowledge does not arrive: a frame with the same
+ *  sequence of the last one executed is acknowledged but not executed
+ *  again. An empty frame resets the sequence.
+ *
+ *  The serial speed can be raised with the baud command. The new speed is
+ *  applied after the command acknowledge has been sent and is kept only if
+ *  a valid frame is received within FRAME_BAUD_CONFIRM_MS, else the link
+ *  goes back to the previous speed.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _FRAMELINK
+#define _FRAMELINK
+
+#include <Arduino.h>
+#include <Streaming.h>
+#include "console.h"
+#include "storage.h"
+
+#define FRAME_STX 0x02          ///< Start of frame
+#define FRAME_ACK 0x06          ///< Frame received, followed by the sequence
+#define FRAME_NAK 0x15          ///< Frame corrupted, followed by the sequence
+#define FRAME_PAYLOAD_MAX 56    ///< Max payload length, the frame fits the serial RX buffer (64 bytes)
+#define FRAME_BYTE_MS 50        ///< Max time (ms) between two bytes of a frame
+#define FRAME_BAUD_DEFAULT 38400UL    ///< Serial speed on boot
+#define FRAME_BAUD_CONFIRM_MS 2000    ///< Max time (ms) to receive a frame at the new speed
+#define FRAME_BAUD_RATES 5      ///< Number of supported speeds
+
+// Receiver states
+#define FRAME_HUNT 0      ///< Waiting for the start byte
+#define FRAME_LENGTH 1    ///< Waiting for the length
+#define FRAME_SEQ 2       ///< Waiting for the sequence
+#define FRAME_PAYLOAD 3   ///< Receiving the payload
+#define FRAME_CRC_HI 4    ///< Waiting for the CRC MSB
+#define FRAME_CRC_LO 5    ///< Waiting for the CRC LSB
+
+#define FRAME_MSG_TITLE "Link baud "
+#define FRAME_MSG_FRAMES " frames "
+#define FRAME_MSG_CRC " crc "
+#define FRAME_MSG_TIMEOUTS " timeouts "
+#define FRAME_MSG_DUPLICATES " duplicates "
+#define FRAME_MSG_REVERTED " reverted "
+
+/**
+ * \brief Receiver of the framed serial link
+ */
+class FrameLink {
+  public:
+
+    //! Current serial speed
+    unsigned long baud = FRAME_BAUD_DEFAULT;
+    //! Frames executed
+    unsigned long frames = 0;
+    //! Frames with wrong CRC or length
+    unsigned long crcErrors = 0;
+    //! Frames not completed within FRAME_BYTE_MS
+    unsigned long timeouts = 0;
+    //! Frames sent again by the master and not executed
+    unsigned long duplicates = 0;
+    //! Speed changes not confirmed by the master
+    unsigned long reverted = 0;
+
+    /**
+     * \brief Read the serial until a new frame is complete. The frames
+     * are acknowledged, the duplicated frames are skipped
+     *
+     * \return true if a frame should be executed, see payload()
+     */
+    boolean receive(void);
+
+    //! \brief The command string of the last frame received
+    const char* payload(void) { return (const char*)buffer; }
+
+    /**
+     * \brief Discard the partial frame if no byte is waiting and none has
+     * been received for FRAME_BYTE_MS, and restore the previous speed if
+     * the new one is not confirmed. Should be called by the main loop
+     */
+    void poll(void);
+
+    /**
+     * \brief Request a new speed, applied by applyBaud()
+     *
+     * \param rate The speed (bps)
+     * \return false if the speed is not supported
+     */
+    boolean setBaud(long rate);
+
+    /**
+     * \brief Apply the speed requested, after sending all the queued
+     * messages. Should be called after the command execution
+     */
+    void applyBaud(void);
+
+    //! \brief Show the speed and the link statistics
+    void showInfo(void);
+
+  private:
+    //! Receiver state
+    uint8_t state = FRAME_HUNT;
+    //! Payload length of the frame being received
+    uint8_t length;
+    //! Sequence of the frame being received
+    uint8_t seq;
+    //! Payload bytes received
+    uint8_t count;
+    //! CRC computed on the received bytes
+    uint16_t crc;
+    //! CRC received
+    uint16_t frameCrc;
+    //! Sequence of the last frame executed, -1 after a reset
+    int lastSeq = -1;
+    //! Time (ms) of the last byte received
+    unsigned long lastByte;
+    //! Speed requested, 0 if none
+    unsigned long newBaud = 0;
+    //! Speed to restore if the new one is not confirmed
+    unsigned long oldBaud = FRAME_BAUD_DEFAULT;
+    //! Time (ms) of the speed change, the speed is confirmed when 0
+    unsigned long baudTime = 0;
+    //! Payload of the last frame, null terminated
+    uint8_t buffer[FRAME_PAYLOAD_MAX + 1];
+
+    //! \brief Discard the partial frame if no byte has been received for FRAME_BYTE_MS
+    void expire(void);
+
+    /**
+     * \brief Send an acknowledge
+     *
+     * \param code FRAME_ACK or FRAME_NAK
+     * \param s The sequence
+     */
+    void reply(uint8_t code, uint8_t s);
+};
+
+//! Framed serial link instance
+extern FrameLink frameLink;
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ *  \file intervalometer.cpp
+ *  \brief This file defines functions and predefined instances from intervalometer.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "intervalometer.h"
+
+boolean Intervalometer::start(unsigned long i, unsigned int n, int t) {
+  if( (t <= 0) || (i < (unsigned long)t + TL_FRAME_OVERHEAD) )
+    return false;
+
+  interval = i;
+  frames = n;
+  exposure = t;
+  framesDone = 0;
+  framesMissed = 0;
+  nextFrame = millis();
+  state = TL_RUNNING;
+
+  return true;
+}
+
+void Intervalometer::pause(void) {
+  long left;
+
+  if(state != TL_RUNNING)
+    return;
+
+  left = (long)(nextFrame - millis());
+  if(left < 0)
+    left = 0;
+  remaining = (unsigned long)left;
+  state = TL_PAUSED;
+}
+
+void Intervalometer::resume(void) {
+  if(state != TL_PAUSED)
+    return;
+
+  nextFrame = millis() + remaining;
+  state = TL_RUNNING;
+}
+
+void Intervalometer::stop(void) {
+  state = TL_IDLE;
+}
+
+boolean Intervalometer::isDue(void) {
+  if(state != TL_RUNNING)
+    return false;
+
+  // Signed difference to survive the millis() rollover
+  return (long)(millis() - nextFrame) >= 0;
+}
+
+void Intervalometer::frameDone(void) {
+  framesDone++;
+
+  if( (frames != 0) && (framesDone >= frames) ) {
+    state = TL_IDLE;
+    return;
+  }
+
+  nextFrame += interval + stretch;
+  // A late frame is shot as soon as possible but if also the following
+  // deadline is already expired while shooting it is skipped
+  while((long)(millis() - (nextFrame + interval)) >= 0) {
+    nextFrame += interval;
+    framesMissed++;
+  }
+}
+
+void Intervalometer::showInfo(void) {
+  if(!LOG_ENABLED(LOG_INFO))
+    return;
+  Print &out = console;
+
+  out << TL_MSG_TITLE << " ";
+
+  switch(state) {
+    case TL_IDLE:
+      out << TL_MSG_IDLE;
+    break;
+    case TL_RUNNING:
+      out << TL_MSG_RUNNING;
+    break;
+    case TL_PAUSED:
+      out << TL_MSG_PAUSED;
+    break;
+  }
+
+  out << TL_MSG_FRAMES << framesDone << "/" << frames;
+  out << TL_MSG_MISSED << framesMissed;
+
+  if(state == TL_RUNNING)
+    out << TL_MSG_NEXT << (long)(nextFrame - millis());
+  else if(state == TL_PAUSED)
+    out << TL_MSG_NEXT << remaining;
+
+  out << endl;
+}
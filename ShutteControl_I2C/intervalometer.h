@@ -0,0 +1,107 @@
+/**
+ *  \file intervalometer.h
+ *  \brief On-device intervalometer for timelapse sequences
+ *
+ *  The frames are scheduled against absolute deadlines (first frame time
+ *  plus n times the interval) so the time spent shooting and the loop
+ *  latency do not accumulate along the sequence.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _INTERVALOMETER
+#define _INTERVALOMETER
+
+#include <Streaming.h>
+#include "shutter.h"
+#include "console.h"
+
+#define TL_IDLE 0       ///< No timelapse in progress
+#define TL_RUNNING 1    ///< Timelapse running
+#define TL_PAUSED 2     ///< Timelapse paused, can be resumed
+
+//! Minimum time (ms) needed by a frame besides the exposure:
+//! two shutter motor cycles plus the release delay
+#define TL_FRAME_OVERHEAD (SH_MOTOR_MS * 2 + 1)
+
+#define TL_MSG_TITLE "Timelapse"
+#define TL_MSG_IDLE "idle"
+#define TL_MSG_RUNNING "running"
+#define TL_MSG_PAUSED "paused"
+#define TL_MSG_FRAMES " frames "
+#define TL_MSG_NEXT " next (ms) "
+#define TL_MSG_MISSED " missed "
+#define TL_MSG_BADPARAM "bad parameters"
+
+/**
+ * \brief Timelapse scheduler
+ *
+ * The class does not shoot by itself: the main loop checks isDue()
+ * and when a frame is due executes the shot then calls frameDone() to
+ * schedule the next deadline.\n
+ * If a frame takes longer than the interval the missed deadlines are
+ * skipped (and counted) instead of shooting a burst to recover them.
+ */
+class Intervalometer {
+  public:
+
+    //! Current state (idle, running, paused)
+    uint8_t state;
+    //! Interval between two frames start (ms)
+    unsigned long interval;
+    //! Number of frames to shoot. 0 means unlimited
+    unsigned int frames;
+    //! Number of frames already shot
+    unsigned int framesDone;
+    //! Number of deadlines skipped because the previous frame was too long
+    unsigned int framesMissed;
+    //! Exposure time of every frame (ms)
+    int exposure;
+    //! Additional time (ms) added to the interval, e.g. by the thermal throttling
+    unsigned long stretch = 0;
+
+    /**
+     * \brief Start a new timelapse sequence. The first frame is due immediately
+     *
+     * \param i Interval between frames in ms
+     * \param n Number of frames, 0 for unlimited
+     * \param t Exposure time in ms
+     * \return false if the parameters are not valid
+     */
+    boolean start(unsigned long i, unsigned int n, int t);
+
+    //! \brief Suspend the sequence saving the time left to the next frame
+    void pause(void);
+
+    //! \brief Restart a paused sequence keeping the time left to the next frame
+    void resume(void);
+
+    //! \brief Cancel the sequence
+    void stop(void);
+
+    /**
+     * \brief Check if the next frame deadline has been reached
+     *
+     * \return true if a frame should be shot now
+     */
+    boolean isDue(void);
+
+    /**
+     * \brief Account the frame just shot and set the next deadline
+     *
+     * The deadline is always moved forward by the interval from the previous
+     * deadline, not from the current time, so the error does not accumulate.
+     */
+    void frameDone(void);
+
+    //! \brief Show the sequence progress to the serial terminal
+    void showInfo(void);
+
+  private:
+    //! Deadline of the next frame (millis)
+    unsigned long nextFrame;
+    //! Time left to the next frame when the sequence has been paused
+    unsigned long remaining;
+};
+
+#endif
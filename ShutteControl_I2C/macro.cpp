@@ -0,0 +1,115 @@
+/**
+ *  \file macro.cpp
+ *  \brief This file defines functions and predefined instances from macro.h
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "macro.h"
+
+//! EEPROM address of a macro slot
+#define slotAddress(x) (EEPROM_MACRO_BASE + (x) * sizeof(macroSlot))
+
+//! Size of the slot data protected by the CRC. The struct can be padded
+//! after the CRC so its offset is used instead of the struct size
+#define SLOT_CRC_SIZE offsetof(macroSlot, crc)
+
+static_assert(MACRO_SLOTS * sizeof(macroSlot) <= EEPROM_MACRO_SIZE, "macro slots exceed the EEPROM area");
+
+boolean MacroStore::record(String name) {
+  if( (name.length() == 0) || (name.length() > MACRO_NAME_LEN) )
+    return false;
+
+  memset(&buffer, 0, sizeof(macroSlot));
+  name.toCharArray(buffer.name, MACRO_NAME_LEN + 1);
+  recording = true;
+
+  return true;
+}
+
+boolean MacroStore::add(const dispatchEntry &entry) {
+  if(buffer.numSteps >= MACRO_MAX_STEPS)
+    return false;
+
+  buffer.steps[buffer.numSteps++] = entry;
+
+  return true;
+}
+
+boolean MacroStore::save(void) {
+  int slot, j;
+  macroSlot data;
+
+  recording = false;
+
+  // Replace the macro with the same name or use the first free slot
+  slot = findSlot(String(buffer.name));
+  for(j = 0; (slot < 0) && (j < MACRO_SLOTS); j++) {
+    if(!readSlot(j, data))
+      slot = j;
+  }
+
+  if(slot < 0)
+    return false;
+
+  buffer.magic = MACRO_MAGIC;
+  buffer.crc = crc16((const uint8_t*)&buffer, SLOT_CRC_SIZE);
+  EEPROM.put(slotAddress(slot), buffer);
+
+  return true;
+}
+
+boolean MacroStore::load(String name) {
+  int slot;
+
+  slot = findSlot(name);
+  if(slot < 0)
+    return false;
+
+  return readSlot(slot, buffer);
+}
+
+boolean MacroStore::remove(String name) {
+  int slot;
+
+  slot = findSlot(name);
+  if(slot < 0)
+    return false;
+
+  // Invalidating the marker is sufficient to free the slot
+  EEPROM.update(slotAddress(slot), 0);
+
+  return true;
+}
+
+void MacroStore::showInfo(void) {
+  int j;
+  macroSlot data;
+  Print &out = console.bulk();
+
+  for(j = 0; j < MACRO_SLOTS; j++) {
+    if(readSlot(j, data))
+      out << MC_MSG_TITLE << " " << data.name << MC_MSG_STEPS << data.numSteps << endl;
+  }
+}
+
+boolean MacroStore::readSlot(int slot, macroSlot &data) {
+  EEPROM.get(slotAddress(slot), data);
+
+  if(data.magic != MACRO_MAGIC)
+    return false;
+
+  return data.crc == crc16((const uint8_t*)&data, SLOT_CRC_SIZE);
+}
+
+int MacroStore::findSlot(String name) {
+  int j;
+  macroSlot data;
+
+  for(j = 0; j < MACRO_SLOTS; j++) {
+    if(readSlot(j, data) && name.equals(data.name))
+      return j;
+  }
+
+  return -1;
+}
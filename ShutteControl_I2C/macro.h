@@ -0,0 +1,129 @@
+/**
+ *  \file macro.h
+ *  \brief Command macros stored in the non volatile memory
+ *  
+ *  A macro is a named sequence of already decoded commands. When a macro
+ *  is executed the dispatcher runs the stored entries directly, without
+ *  host round trips and without parsing the command strings again.
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _MACRO
+#define _MACRO
+
+#include <Streaming.h>
+#include "commands.h"
+#include "storage.h"
+#include "console.h"
+
+#define MACRO_SLOTS 4         ///< Number of macros that can be stored
+#define MACRO_MAX_STEPS 12    ///< Max number of commands in a macro
+#define MACRO_NAME_LEN 8      ///< Max length of the macro name
+#define MACRO_MAGIC 0xA5      ///< Marker of a used slot
+
+#define MC_MSG_TITLE "Macro"
+#define MC_MSG_RECORDING "recording "
+#define MC_MSG_RECORDED "recorded "
+#define MC_MSG_SAVED "saved "
+#define MC_MSG_DELETED "deleted "
+#define MC_MSG_RUNNING "running "
+#define MC_MSG_NOTFOUND "not found "
+#define MC_MSG_FULL "no space left"
+#define MC_MSG_BADNAME "bad name"
+#define MC_MSG_NOTRECORDING "not recording"
+#define MC_MSG_STEPS " steps "
+
+/**
+ * Macro slot as saved in the EEPROM
+ */
+struct macroSlot {
+  uint8_t magic;                          ///< MACRO_MAGIC if the slot is in use
+  uint8_t numSteps;                       ///< Number of commands in the macro
+  char name[MACRO_NAME_LEN + 1];          ///< Macro name, zero terminated
+  dispatchEntry steps[MACRO_MAX_STEPS];   ///< Decoded commands
+  uint16_t crc;                           ///< CRC-16 of all the previous fields
+};
+
+/**
+ * \brief Record, save and load the command macros
+ * 
+ * The macro being recorded or the last macro loaded is kept in the
+ * class buffer; only one macro at a time is in memory.
+ */
+class MacroStore {
+  public:
+
+    //! Macro being recorded or loaded for execution
+    macroSlot buffer;
+
+    /**
+     * \brief Start recording a new macro. The following commands
+     * are added to the macro instead of being executed
+     * 
+     * \param name The macro name
+     * \return false if the name is not valid
+     */
+    boolean record(String name);
+
+    /**
+     * \brief Add a decoded command to the macro being recorded
+     * 
+     * \param entry The decoded command
+     * \return false if the macro is full
+     */
+    boolean add(const dispatchEntry &entry);
+
+    /**
+     * \brief Stop recording and save the macro, replacing the one with
+     * the same name if it exists
+     * 
+     * \return false if there are no free slots
+     */
+    boolean save(void);
+
+    /**
+     * \brief Load a macro in the buffer
+     * 
+     * \param name The macro name
+     * \return false if the macro does not exist
+     */
+    boolean load(String name);
+
+    /**
+     * \brief Delete a stored macro
+     * 
+     * \param name The macro name
+     * \return false if the macro does not exist
+     */
+    boolean remove(String name);
+
+    //! \brief Check if a macro is being recorded
+    boolean isRecording(void) { return recording; }
+
+    //! \brief Show the list of the stored macros to the serial terminal
+    void showInfo(void);
+
+  private:
+    //! Recording status
+    boolean recording;
+
+    /**
+     * \brief Read a slot from the EEPROM and check its integrity
+     * 
+     * \param slot The slot number
+     * \param data The slot content
+     * \return true if the slot is in use and valid
+     */
+    boolean readSlot(int slot, macroSlot &data);
+
+    /**
+     * \brief Find the slot of a macro
+     * 
+     * \param name The macro name
+     * \return The slot number or -1 if the macro does not exist
+     */
+    int findSlot(String name);
+};
+
+#endif
@@ -16,7 +16,6 @@
 //! Application title shown on startup and after reset
 #define APP_TITLE "CM3 I2C PONF Ver.0.0.8"
 
-#define _HIGHCURRENT
 #undef _MOTORDEBUG
 
 //! Avoid too many openload error messages when starting acceleration
@@ -38,6 +37,13 @@
 #define MOTOR_ENABLED 1
 #define MOTOR_DISABLED 0
 
+#define MOTOR_STOP_COAST 0  ///< Stop with the half bridges floating, the motor coasts down
+#define MOTOR_STOP_BRAKE 1  ///< Stop with both the poles low, the motor is braked until the next start
+#define MOTOR_STOP_TIMED 2  ///< Stop with both the poles low, then floating after the brake time
+#define MOTOR_BRAKE_MS 20   ///< Default brake time (ms) of the timed brake stop
+#define MOTOR_BRAKE_MAX_MS 1000 ///< Max brake time (ms) of the timed brake stop
+#define MOTOR_MOVE_MAX_MS 10000 ///< Max duration (ms) of a motor move command
+
 #define RAMP_ON true     ///< Acceleration enabled on start
 #define RAMP_OFF false    ///< Acceleration disabled on start
 
@@ -47,30 +53,48 @@
 #define DUTYCYCLE_MIN 0     ///< Minimum duty cycle for motor start. Depends on motor characteristics
 #define DUTYCYCLE_MAX 255   ///< Maximum duty cycle
 #define RAMP_STEP_DELAY 2   ///< Delay (ms) between steps during an acceleration/deceleration cycle
+#define ANALOG_DC_STEP 4    ///< Max duty cycle change every step in manual duty cycle mode
+#define ANALOG_DC_STEP_MS RAMP_STEP_DELAY ///< Time (ms) between two manual duty cycle steps
 
 #define AVAIL_PWM_CHANNELS 3  ///< Number of available PWM channels (excluding the NOPWM mode)
-#define PWM80_CHID 1          ///< ID for PWM channel 80 Hz
-#define PWM100_CHID 2         ///< ID for PWM channel 100 Hz
-#define PWM200_CHID 3         ///< ID for PWM channel 200 Hz
-
-/**
- * When _HIGHCURRENT is set every motor needs 2+2 half bridges to double the needed power
- */
-#undef _HIGHCURRENT
-
-#ifdef _HIGHCURRENT
-  //! In high current mode every pole of the motors is connected to two half bridges
-  #define MAX_MOTORS 3
-  //! Calculate the first half bridge number depending
-  //! on the motor number
-  #define calcHB1(x) ((x - 1) * 4 + 1)
-#else
-  //! In normal mode every motor uses two half bridges
-  #define MAX_MOTORS 6
-  //! Calculate the first half bridge number depending
-  //! on the motor number
-  #define calcHB1(x) ((x - 1) * 2 + 1)
-#endif
+#define PWM80_CHID 1          ///< ID for PWM channel 80 Hz (default binding)
+#define PWM100_CHID 2         ///< ID for PWM channel 100 Hz (default binding)
+#define PWM200_CHID 3         ///< ID for PWM channel 200 Hz (default binding)
+
+//! Diagnostic flags meaning that the TLE94112 configuration has been lost
+#define TLE_RECOVERY_FLAGS (Tle94112::TLE_POWER_ON_RESET | Tle94112::TLE_SPI_ERROR)
+#define TLE_RECOVERY_RETRIES 3    ///< Max attempts to recover the TLE94112
+#define TLE_RECOVERY_MS 20        ///< Max time (ms) spent recovering the TLE94112
+#define TLE_HEALTH_CHECK_MS 500   ///< Time (ms) between two TLE94112 status checks
+
+//! Delay (us) between two groups of motors when starting all the motors, to
+//! avoid the under voltage caused by the inrush current on battery power
+#define START_STAGGER_US 500
+//! Max sum of the motors current classes started together (a high current
+//! motor alone or two normal motors)
+#define START_CURRENT_BUDGET MOTOR_CURRENT_HIGH
+
+//! Number of half bridges of the TLE94112
+#define NUM_HB 12
+
+//! Normal current motor: every pole is connected to one half bridge
+#define MOTOR_CURRENT_NORMAL 1
+//! High current motor: every pole is connected to two half bridges
+//! to double the available current
+#define MOTOR_CURRENT_HIGH 2
+//! Max number of half bridges connected to a motor pole
+#define MAX_HB_PER_POLE MOTOR_CURRENT_HIGH
+
+//! Max number of motors, when all are in normal current
+#define MAX_MOTORS (NUM_HB / (2 * MOTOR_CURRENT_NORMAL))
+
+//! Current class of the motors as they are wired to the shield. The half bridges are
+//! allocated in the motor order; with the shutter motor in high current the other four
+//! motors still fit while the sixth is left without half bridges. The classes can't be
+//! changed at runtime: a different class moves half bridges between the poles of a motor
+//! and between the motors, shorting the half bridges wired in parallel
+#define MOTOR_CURRENT_WIRING { MOTOR_CURRENT_HIGH, MOTOR_CURRENT_NORMAL, MOTOR_CURRENT_NORMAL, \
+                                MOTOR_CURRENT_NORMAL, MOTOR_CURRENT_NORMAL, MOTOR_CURRENT_NORMAL }
 
 // ======================================================================
 //        Generic Strings
@@ -87,6 +111,11 @@
 #define TLE_TEMPSHUTDOWN "Temp shutdown"
 #define TLE_TEMPWARNING "Warning too hot"
 
+#define TLE_RECOVERED "TLE94112 recovered, attempts "
+#define TLE_RECOVERY_FAILED "TLE94112 recovery failed"
+
+#define TLE_START_UNDERVOLTAGE "Under voltage events on start "
+
 #define TLE_MOTOR_STARTING "Starting"
 #define TLE_MOTOR_STOPPING "Stopping"
 #define TLE_MOTOR_HALT "Halted"
@@ -108,8 +137,8 @@
 #define INFO_MAIN_HEADER2     "*************************************"
 #define INFO_MOTORS_TITLE     "      Motors configuration"
 #define INFO_PWM_TITLE        "       PWM Channels settings"
-#define INfO_TAB_HEADER1      "|Motor|Enabled|Active FW|Dir|PWM|"
-#define INfO_TAB_HEADER2      "|-----+-------+---------+---+---|"
+#define INfO_TAB_HEADER1      "|Motor|Enabled|Active FW|Dir|PWM|HBs|"
+#define INfO_TAB_HEADER2      "|-----+-------+---------+---+---+---|"
 #define INfO_TAB_HEADER3      "|PWM Chan|DC Min|DC Max|DC Man|Accel|"
 #define INfO_TAB_HEADER4      "|--------+------+------+------+-----|"
 
@@ -139,9 +168,27 @@
 #define INFO_FIELD9_80 " 80|"
 #define INFO_FIELD9_100 "100|"
 #define INFO_FIELD9_200 "200|"
+#define INFO_FIELD9_2K " 2k|"
+
+#define INFO_FIELD11_NO "  -|"
+#define INFO_FIELD11A "  "
+#define INFO_FIELD11B "|"
 
 #define INFO_FIELD10_80 "|  80 Hz |"
 #define INFO_FIELD10_100 "| 100 Hz |"
 #define INFO_FIELD10_200 "| 200 Hz |"
+#define INFO_FIELD10_2K "|  2 kHz |"
+#define INFO_FIELD10_NO "|   Off  |"
+
+#define INFO_RECOVERIES "TLE94112 recoveries "
+#define INFO_RECOVERY_FAILED " failed "
+#define INFO_STAGGER "Start stagger (us) "
+#define INFO_BUDGET " budget "
+#define INFO_START_TIME " last start (us) "
+#define INFO_START_UV " under voltage "
+#define INFO_STOP_MODE "Stop mode"
+#define INFO_STOP_COAST " coast"
+#define INFO_STOP_BRAKE " brake"
+#define INFO_STOP_TIMED " brake(ms) "
 
 #endif
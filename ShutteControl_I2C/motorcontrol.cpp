@@ -10,23 +10,67 @@
  */
 
 #include "motorcontrol.h"
+#include "capture.h"
+#include "stats.h"
+
+//! The TLE94112 half bridges, ordered by number
+static constexpr Tle94112::HalfBridge halfBridge[NUM_HB] = {
+  Tle94112::TLE_HB1, Tle94112::TLE_HB2, Tle94112::TLE_HB3, Tle94112::TLE_HB4,
+  Tle94112::TLE_HB5, Tle94112::TLE_HB6, Tle94112::TLE_HB7, Tle94112::TLE_HB8,
+  Tle94112::TLE_HB9, Tle94112::TLE_HB10, Tle94112::TLE_HB11, Tle94112::TLE_HB12
+};
+
+//! Default frequency of the PWM channels
+static constexpr uint8_t defaultFreq[AVAIL_PWM_CHANNELS] = {
+  Tle94112::TLE_FREQ80HZ, Tle94112::TLE_FREQ100HZ, Tle94112::TLE_FREQ200HZ
+};
+
+//! Current class of the motors as they are wired
+static constexpr uint8_t wiredCurrent[MAX_MOTORS] = MOTOR_CURRENT_WIRING;
 
 // ===============================================================
 // Initialization and reset methods
 // ===============================================================
 
-void MotorControl::begin(void) {
+void MotorControl::begin(const motorProfile* profile) {
   // enable tle94112
   tle94112.begin();
-  
-  reset();
+
+  setDefaults();
+  if(profile != NULL)
+    setProfile(*profile);
+  apply();
 }
 
 void MotorControl::end(void) {
   tle94112.end();
 }
 
+void MotorControl::restore(void) {
+  tle94112.begin();
+
+  resetHB();
+  resumeHB();
+}
+
+boolean MotorControl::isBusy(void) {
+  int j;
+
+  for(j = 0; j < MAX_MOTORS; j++) {
+    if(internalStatus[j].isRunning || braking[j])
+      return true;
+  }
+
+  return false;
+}
+
 void MotorControl::reset() {
+
+  setDefaults();
+  apply();
+}
+
+void MotorControl::setDefaults(void) {
   int j;
 
   for(j = 0; j < MAX_MOTORS; j++) {
@@ -35,6 +79,11 @@ void MotorControl::reset() {
     internalStatus[j].isRunning = false;    // Not running (should be enabled)
     internalStatus[j].freeWheeling = true;  // Free wheeling active
     internalStatus[j].motorDirection = MOTOR_DIRECTION_CW;
+    internalStatus[j].currentClass = wiredCurrent[j];
+    internalStatus[j].stopMode = MOTOR_STOP_COAST;
+    internalStatus[j].brakeMs = MOTOR_BRAKE_MS;
+    braking[j] = false;
+    braked[j] = false;
   } // loop on the motors array
 
   for(j = 0; j < AVAIL_PWM_CHANNELS; j++) {
@@ -42,35 +91,115 @@ void MotorControl::reset() {
     dutyCyclePWM[j].maxDC = DUTYCYCLE_MAX;  // Max duty cycle
     dutyCyclePWM[j].manDC = false;          // Duty cycle in auto mode
     dutyCyclePWM[j].useRamp = false;        // No acceleration
+    dutyCyclePWM[j].freq = defaultFreq[j];  // Default frequency binding
   } // loop on the PWM channels array
 
-  resetHB();
-  resetPWM();
   currentPWM = 0; // No PWM channels selected
   currentMotor = 0; // No motors selected
+  recovering = false;
+  dcLimit = 100;  // No thermal limit
+  staggerUs = START_STAGGER_US;
+  startBudget = START_CURRENT_BUDGET;
+}
+
+void MotorControl::apply(void) {
+  int j;
+
+  allocateHB();
+  resetHB();
+  for(j = 0; j < MAX_MOTORS; j++)
+    braked[j] = false;
+  resetPWM();
+  hasManualDC = false;
+}
+
+void MotorControl::getProfile(motorProfile &profile) {
+  memcpy(profile.motors, internalStatus, sizeof(internalStatus));
+  memcpy(profile.pwm, dutyCyclePWM, sizeof(dutyCyclePWM));
+}
+
+void MotorControl::setProfile(const motorProfile &profile) {
+  int j;
+
+  memcpy(internalStatus, profile.motors, sizeof(internalStatus));
+  memcpy(dutyCyclePWM, profile.pwm, sizeof(dutyCyclePWM));
+
+  // Runtime status is never restored, the current class is the wiring
+  for(j = 0; j < MAX_MOTORS; j++) {
+    internalStatus[j].isRunning = false;
+    internalStatus[j].currentClass = wiredCurrent[j];
+  }
+  for(j = 0; j < AVAIL_PWM_CHANNELS; j++)
+    dutyCyclePWM[j].curDC = 0;
 }
 
 void MotorControl::resetHB(void) {
+  int j;
+
   // Set all the half bridges floating without pwm
-  tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-  tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
+  for(j = 0; j < NUM_HB; j++)
+    hbWrite(halfBridge[j], tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
 }
 
 void MotorControl::resetPWM(void) {
-  // Initialize the PWM channels to the corresponding frequency and duty cycle 0
-  tle94112.configPWM(tle94112.TLE_PWM1, tle94112.TLE_FREQ80HZ, (uint8_t)0);
-  tle94112.configPWM(tle94112.TLE_PWM2, tle94112.TLE_FREQ100HZ, (uint8_t)0);
-  tle94112.configPWM(tle94112.TLE_PWM3, tle94112.TLE_FREQ200HZ, (uint8_t)0);
+  int j;
+
+  // Initialize the PWM channels to the bound frequency and duty cycle 0
+  for(j = 0; j < AVAIL_PWM_CHANNELS; j++)
+    pwmWrite(j, 0);
+}
+
+void MotorControl::pwmWrite(int channel, uint8_t dc) {
+  dutyCyclePWM[channel].curDC = dc;
+  // The thermal limit is applied to the written value only
+  dc = (uint8_t)(((unsigned int)dc * dcLimit) / 100);
+  tle94112.configPWM((Tle94112::PWMChannel)(channel + 1), (Tle94112::PWMFreq)dutyCyclePWM[channel].freq, dc);
+  stats.spiWrites++;
+  capture.tlePWM(channel + 1, dutyCyclePWM[channel].freq, dc);
+}
+
+void MotorControl::setDCLimit(uint8_t limit) {
+  int j;
+
+  dcLimit = limit;
+  // The running channels are written again with the new limit
+  for(j = 0; j < AVAIL_PWM_CHANNELS; j++) {
+    if(dutyCyclePWM[j].curDC != 0)
+      pwmWrite(j, dutyCyclePWM[j].curDC);
+  }
+}
+
+unsigned long MotorControl::runningTime(int motor) {
+  if(internalStatus[motor].isRunning)
+    return onTime[motor] + (millis() - runStart[motor]);
+  return onTime[motor];
+}
+
+void MotorControl::hbWrite(Tle94112::HalfBridge hb, Tle94112::HBState state, Tle94112::PWMChannel pwm) {
+  tle94112.configHB(hb, state, pwm);
+  stats.spiWrites++;
+  capture.tleHB(hb, state, pwm, CAP_FW_DEFAULT);
+}
+
+void MotorControl::hbWrite(Tle94112::HalfBridge hb, Tle94112::HBState state, Tle94112::PWMChannel pwm, uint8_t fw) {
+  tle94112.configHB(hb, state, pwm, fw);
+  stats.spiWrites++;
+  capture.tleHB(hb, state, pwm, fw);
+}
+
+uint8_t MotorControl::readDiagnosis(void) {
+  stats.spiReads++;
+  return tle94112.getSysDiagnosis();
+}
+
+uint8_t MotorControl::readDiagnosis(uint8_t flags) {
+  stats.spiReads++;
+  return tle94112.getSysDiagnosis(flags);
+}
+
+void MotorControl::clearDiagnosis(void) {
+  tle94112.clearErrors();
+  stats.spiWrites++;
 }
 
 // ===============================================================
@@ -101,6 +230,32 @@ void MotorControl::setMotorDirection(int dir) {
   }
 }
 
+void MotorControl::allocateHB(void) {
+  int j, k, hb, n;
+
+  hb = 0;
+  numMotors = 0;
+
+  for(j = 0; j < MAX_MOTORS; j++) {
+    n = internalStatus[j].currentClass;
+
+    // Not enough half bridges left for this motor
+    if(hb + 2 * n > NUM_HB) {
+      hbMap[j].numHB = 0;
+      internalStatus[j].isEnabled = false;
+      continue;
+    }
+
+    hbMap[j].numHB = n;
+    for(k = 0; k < n; k++) {
+      hbMap[j].poleA[k] = halfBridge[hb + k];
+      hbMap[j].poleB[k] = halfBridge[hb + n + k];
+    }
+    hb += 2 * n;
+    numMotors++;
+  }
+}
+
 void MotorControl::setMotorFreeWheeling(boolean fw) {
   if(currentMotor != 0) {
     internalStatus[currentMotor - 1].freeWheeling = fw;
@@ -113,6 +268,17 @@ void MotorControl::setMotorFreeWheeling(boolean fw) {
   }
 }
 
+void MotorControl::setMotorStopMode(uint8_t mode, unsigned int ms) {
+  int j;
+
+  for (j = 0; j < MAX_MOTORS; j++) {
+    if( (currentMotor == 0) || (currentMotor == j + 1) ) {
+      internalStatus[j].stopMode = mode;
+      internalStatus[j].brakeMs = ms;
+    }
+  }
+}
+
 // ===============================================================
 // Setting PWM methods
 // ===============================================================
@@ -167,13 +333,108 @@ void MotorControl::setPWMRamp(boolean acc) {
   }
 }
 
+void MotorControl::setPWMFrequency(uint8_t freq) {
+  int j;
+
+  for (j = 0; j < AVAIL_PWM_CHANNELS; j++) {
+    if( (currentPWM == 0) || (currentPWM == j + 1) ) {
+      dutyCyclePWM[j].freq = freq;
+      pwmWrite(j, 0);
+    }
+  }
+}
+
+int MotorControl::pwmFrequencyCode(long hz) {
+  switch(hz) {
+    case 0:
+      return Tle94112::TLE_FREQNONE;
+    case 80:
+      return Tle94112::TLE_FREQ80HZ;
+    case 100:
+      return Tle94112::TLE_FREQ100HZ;
+    case 200:
+      return Tle94112::TLE_FREQ200HZ;
+    case 2000:
+      return Tle94112::TLE_FREQ2KHZ;
+  }
+
+  return -1;
+}
+
+boolean MotorControl::isPWMUsed(int channel, int exclude) {
+  int j;
+
+  for (j = 0; j < MAX_MOTORS; j++) {
+    if( (j != exclude) && (internalStatus[j].channelPWM == channel + 1) )
+      return true;
+  }
+
+  return false;
+}
+
+boolean MotorControl::requestPWM(uint8_t freq, uint8_t dc) {
+  int j, channel;
+
+  if(currentMotor == 0)
+    return false;
+
+  if(freq == tle94112.TLE_FREQNONE) {
+    internalStatus[currentMotor - 1].channelPWM = tle94112.TLE_NOPWM;
+    return true;
+  }
+
+  // Share a channel with the same settings already in use
+  channel = -1;
+  for(j = 0; (channel < 0) && (j < AVAIL_PWM_CHANNELS); j++) {
+    if( (dutyCyclePWM[j].freq == freq) && (dutyCyclePWM[j].maxDC == dc) &&
+        isPWMUsed(j, currentMotor - 1) )
+      channel = j;
+  }
+
+  // Else bind a free channel (the motor own channel is free if not shared)
+  for(j = 0; (channel < 0) && (j < AVAIL_PWM_CHANNELS); j++) {
+    if(!isPWMUsed(j, currentMotor - 1)) {
+      channel = j;
+      dutyCyclePWM[j].freq = freq;
+      dutyCyclePWM[j].maxDC = dc;
+      pwmWrite(j, 0);
+    }
+  }
+
+  if(channel < 0)
+    return false;
+
+  internalStatus[currentMotor - 1].channelPWM = channel + 1;
+
+  return true;
+}
+
 // ===============================================================
 // Motor control action
 // ===============================================================
 
 void MotorControl::startMotors(void) {
+  unsigned int events;
+  unsigned long start;
+
+  events = underVoltages;
+  start = micros();
+
+  // The PWM channels are started with the motor groups
   motorConfigHB();
-  motorPWMStart();
+  // Catch the events raised after the last half bridge configuration
+  if(tleCheckDiagnostic())
+    tleDiagnostic();
+
+  lastStartTime = micros() - start;
+  lastStartEvents = underVoltages - events;
+  if(lastStartEvents != 0)
+    CONSOLE_LOG(LOG_WARNING) << TLE_START_UNDERVOLTAGE << lastStartEvents << endl;
+}
+
+void MotorControl::setStartStagger(unsigned int us, uint8_t budget) {
+  staggerUs = us;
+  startBudget = budget;
 }
 
 void MotorControl::stopMotors(void) {
@@ -194,25 +455,28 @@ void MotorControl::stopMotor(int m) {
 }
 
 void MotorControl::motorPWMAnalogDC(void) {
-  int j;
-  
+  int j, dc;
+
+  if(!hasManualDC || ((millis() - lastAnalogStep) < ANALOG_DC_STEP_MS))
+    return;
+  lastAnalogStep = millis();
+
   // Loop on the PWM channels
   for (j = 0; j < AVAIL_PWM_CHANNELS; j++) {
     // See if the channel is set for manual dutycycle
-    if(dutyCyclePWM[j].manDC) {
-      // If new value is bigger than previous, arrange
-      // the DC value for acceleration else do the opposite
-      if(lastAnalogDC > prevAnalogDC) {
-        dutyCyclePWM[j].minDC = prevAnalogDC;
-        dutyCyclePWM[j].maxDC = lastAnalogDC;
-        motorPWMAccelerate(j);
-      }
-      else {
-        dutyCyclePWM[j].maxDC = prevAnalogDC;
-        dutyCyclePWM[j].minDC = lastAnalogDC;
-        motorPWMDecelerate(j);
-      }
-    }
+    if(!dutyCyclePWM[j].manDC)
+      continue;
+    // The pot value is the target for the next start too
+    dutyCyclePWM[j].maxDC = lastAnalogDC;
+    dc = dutyCyclePWM[j].curDC;
+    if(dc == lastAnalogDC)
+      continue;
+    // Limited step toward the new value
+    if(dc < lastAnalogDC)
+      dc = min(dc + ANALOG_DC_STEP, (int)lastAnalogDC);
+    else
+      dc = max(dc - ANALOG_DC_STEP, (int)lastAnalogDC);
+    pwmWrite(j, (uint8_t)dc);
   }
 }
 
@@ -222,22 +486,29 @@ void MotorControl::motorPWMStart(void) {
   hasManualDC = false;
   
   // Loop on the PWM channels
-  for (j = 0; j < AVAIL_PWM_CHANNELS; j++) {
-    // See if the channel is set for manual dutycycle
-    if(dutyCyclePWM[j].manDC)
-      hasManualDC = true; // Save the global flag for the program logic
-    // Start PWM channel of acceleration cycle
-    if(dutyCyclePWM[j].useRamp) {
-      // Should manage acceleration
-      motorPWMAccelerate(j);
-    }
-    else
-      motorPWMRun(j);
+  for (j = 0; j < AVAIL_PWM_CHANNELS; j++)
+    motorPWMStart(j);
+}
+
+void MotorControl::motorPWMStart(int channel) {
+  // See if the channel is set for manual dutycycle
+  if(dutyCyclePWM[channel].manDC) {
+    hasManualDC = true; // Save the global flag for the program logic
+    dutyCyclePWM[channel].maxDC = lastAnalogDC;
   }
+  // Start PWM channel of acceleration cycle
+  if(dutyCyclePWM[channel].useRamp) {
+    // Should manage acceleration
+    motorPWMAccelerate(channel);
+  }
+  else
+    motorPWMRun(channel);
 }
 
 void MotorControl::motorPWMStop(void) {
   int j;
+
+  hasManualDC = false;
   
   // Loop on the PWM channels
   for (j = 0; j < AVAIL_PWM_CHANNELS; j++) {
@@ -255,17 +526,7 @@ void MotorControl::motorPWMAccelerate(int channel) {
   int j;
 
   for(j = dutyCyclePWM[channel].minDC; j < dutyCyclePWM[channel].maxDC; j++) {
-    switch(channel + 1){
-      case PWM80_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM1, tle94112.TLE_FREQ80HZ, (uint8_t)j);
-      break;
-      case PWM100_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM2, tle94112.TLE_FREQ100HZ, (uint8_t)j);
-      break;
-      case PWM200_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM3, tle94112.TLE_FREQ200HZ, (uint8_t)j);
-      break;
-    }
+    pwmWrite(channel, (uint8_t)j);
     //Check for error
     if(tleCheckDiagnostic()) {
       tleDiagnostic();
@@ -275,31 +536,11 @@ void MotorControl::motorPWMAccelerate(int channel) {
 }
 
 void MotorControl::motorPWMRun(int channel) {
-  switch(channel + 1){
-    case PWM80_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM1, tle94112.TLE_FREQ80HZ, dutyCyclePWM[channel].maxDC);
-    break;
-    case PWM100_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM2, tle94112.TLE_FREQ100HZ, dutyCyclePWM[channel].maxDC);
-    break;
-    case PWM200_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM3, tle94112.TLE_FREQ200HZ, dutyCyclePWM[channel].maxDC);
-    break;
-  }
+  pwmWrite(channel, dutyCyclePWM[channel].maxDC);
 }
 
 void MotorControl::motorPWMHalt(int channel) {
-  switch(channel + 1){
-    case PWM80_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM1, tle94112.TLE_FREQ80HZ, (uint8_t)0);
-    break;
-    case PWM100_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM2, tle94112.TLE_FREQ100HZ, (uint8_t)0);
-    break;
-    case PWM200_CHID:
-      tle94112.configPWM(tle94112.TLE_PWM3, tle94112.TLE_FREQ200HZ, (uint8_t)0);
-    break;
-  }
+  pwmWrite(channel, 0);
 }
 
 void MotorControl::motorPWMDecelerate(int channel) {
@@ -307,17 +548,7 @@ void MotorControl::motorPWMDecelerate(int channel) {
   
   for(j = dutyCyclePWM[channel].maxDC; j > dutyCyclePWM[channel].minDC; j--) {
     // Update the speed
-    switch(channel + 1){
-      case PWM80_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM1, tle94112.TLE_FREQ80HZ, (uint8_t)j);
-      break;
-      case PWM100_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM2, tle94112.TLE_FREQ100HZ, (uint8_t)j);
-      break;
-      case PWM200_CHID:
-        tle94112.configPWM(tle94112.TLE_PWM3, tle94112.TLE_FREQ200HZ, (uint8_t)j);
-      break;
-    }
+    pwmWrite(channel, (uint8_t)j);
     //Check for error
     if(tleCheckDiagnostic()) {
       tleDiagnostic();
@@ -331,14 +562,42 @@ void MotorControl::motorPWMDecelerate(int channel) {
 // ===============================================================
 
 void MotorControl::motorConfigHB(void) {
-  int j;
-    for(j = 0; j < MAX_MOTORS; j++) {
-      motorConfigHB(j);
+  int j, used, channel;
+  boolean started[AVAIL_PWM_CHANNELS] = { false };
+
+  hasManualDC = false;
+
+  // The motors are energised in groups within the current budget,
+  // waiting the inrush of a group before starting the next one.
+  // The PWM motors draw current when their channel starts, so the
+  // channel is started with the first motor using it
+  used = 0;
+  for(j = 0; j < MAX_MOTORS; j++) {
+    if(!internalStatus[j].isEnabled || (hbMap[j].numHB == 0))
+      continue;
+    if( (used > 0) && (used + internalStatus[j].currentClass > startBudget) ) {
+      delayMicroseconds(staggerUs);
+      used = 0;
     }
+    used += internalStatus[j].currentClass;
+    motorConfigHB(j);
+
+    channel = internalStatus[j].channelPWM - 1;
+    if( (internalStatus[j].channelPWM != tle94112.TLE_NOPWM) && !started[channel] ) {
+      motorPWMStart(channel);
+      started[channel] = true;
+    }
+  }
+
+  // The channels not used by the started motors
+  for(j = 0; j < AVAIL_PWM_CHANNELS; j++) {
+    if(!started[j])
+      motorPWMStart(j);
+  }
 }
 
 void MotorControl::motorConfigHB(int motor) {
-  if(internalStatus[motor].isEnabled) {
+  if(internalStatus[motor].isEnabled && (hbMap[motor].numHB != 0)) {
     if(internalStatus[motor].motorDirection == MOTOR_DIRECTION_CW)
       motorConfigHBCW(motor);
     else
@@ -361,474 +620,93 @@ void MotorControl::motorStopHB(void) {
 }
 
 void MotorControl::motorStopHB(int motor) {
-  int hb1;
+  // Set motor stopped and account the running time
+  if(internalStatus[motor].isRunning)
+    onTime[motor] += millis() - runStart[motor];
+  internalStatus[motor].isRunning = false;
 
-  // Calculate the first half bridge depending on the motor ID
-  // Note that HB are numbered base 1 while motor is index array base 0
-  // and HB usage is different if high current mode is selected in the
-  // preprocessor directive
-  hb1 = calcHB1(motor + 1);
+  if(internalStatus[motor].stopMode == MOTOR_STOP_COAST) {
+    braked[motor] = false;
+    motorPolesWrite(motor, tle94112.TLE_FLOATING);
+    return;
+  }
 
-  // Set motor stopped
-  internalStatus[motor].isRunning = false;
-  
-  // Select the half bridges to configure the motor.
-  // Depending on the mode (normal = 1 + 1 HB per motor, high current = 2+2)
-  // not all the half bridges can be the first (=hb1)
-  switch(hb1) {
-    // -------------------------------------------------
-    // Motor 1 (in both modes)
-    // -------------------------------------------------
-    case 1: 
-      tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #endif
-    break;
-    // -------------------------------------------------
-    // Motor 2 (no high current mode)
-    // -------------------------------------------------
-    case 3: 
-      tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-    break;
-    // -------------------------------------------------
-    // Motor 3 (Motor 2 in high current mode)
-    // -------------------------------------------------
-    case 5: 
-      tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB7,  tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #endif
-    break;
-    // -------------------------------------------------
-    // Motor 4 (no high current mode)
-    // -------------------------------------------------
-    case 7:  
-      tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-    break;
-    // -------------------------------------------------
-    // Motor 5 ((Motor 3 in high current mode)
-    // -------------------------------------------------
-    case 9: 
-      tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB11,  tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      #endif
-    break;
-    // -------------------------------------------------
-    // Motor 6 (no high current mode)
-    // -------------------------------------------------
-    case 11:
-      tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-      tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_FLOATING, tle94112.TLE_NOPWM);
-    break;
+  // Brake: both the poles low short the motor windings
+  braked[motor] = true;
+  motorPolesWrite(motor, tle94112.TLE_LOW);
+  if(internalStatus[motor].stopMode == MOTOR_STOP_TIMED) {
+    braking[motor] = true;
+    brakeStart[motor] = millis();
   }
 }
 
-void MotorControl::motorConfigHBCW(int motor) {
-  int hb1;
+void MotorControl::motorBrakeRelease(void) {
+  int j;
 
-  // Calculate the first half bridge depending on the motor ID
-  // Note that HB are numbered base 1 while motor is index array base 0
-  // and HB usage is different if high current mode is selected in the
-  // preprocessor directive
-  hb1 = calcHB1(motor + 1);
+  for(j = 0; j < MAX_MOTORS; j++) {
+    if(!braking[j] || ((millis() - brakeStart[j]) < internalStatus[j].brakeMs))
+      continue;
+    braking[j] = false;
+    // Restarted while braking
+    if(internalStatus[j].isRunning)
+      continue;
+    braked[j] = false;
+    motorPolesWrite(j, tle94112.TLE_FLOATING);
+  }
+}
 
-  // Set motor running
-  internalStatus[motor].isRunning = true;
-  
-  // Select the half bridges to configure the motor.
-  // Depending on the mode (normal = 1 + 1 HB per motor, high current = 2+2)
-  // not all the half bridges can be the first (=hb1)
-  switch(hb1) {
-    // -------------------------------------------------
-    // Motor 1 (in both modes)
-    // -------------------------------------------------
-    case 1: 
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #else
-      tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 2 (no high current mode)
-    // -------------------------------------------------
-    case 3: 
-      tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 3 (Motor 2 in high current mode)
-    // -------------------------------------------------
-    case 5: 
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #else
-      tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 4 (no high current mode)
-    // -------------------------------------------------
-    case 7:  
-      tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 5 ((Motor 3 in high current mode)
-    // -------------------------------------------------
-    case 9: 
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #else
-      tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 6 (no high current mode)
-    // -------------------------------------------------
-    case 11:
-      tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
+void MotorControl::resumeHB(void) {
+  int j;
+
+  for(j = 0; j < AVAIL_PWM_CHANNELS; j++)
+    pwmWrite(j, dutyCyclePWM[j].curDC);
+  for(j = 0; j < MAX_MOTORS; j++) {
+    if(internalStatus[j].isRunning) {
+      if(internalStatus[j].motorDirection == MOTOR_DIRECTION_CW)
+        motorConfigHBCW(j);
+      else
+        motorConfigHBCCW(j);
+    }
+    else if(braked[j])
+      motorPolesWrite(j, tle94112.TLE_LOW);
   }
 }
 
+void MotorControl::motorPolesWrite(int motor, Tle94112::HBState state) {
+  int j;
+
+  // All the half bridges of pole A, then all the half bridges of pole B
+  for(j = 0; j < hbMap[motor].numHB; j++)
+    hbWrite(hbMap[motor].poleA[j], state, tle94112.TLE_NOPWM);
+  for(j = 0; j < hbMap[motor].numHB; j++)
+    hbWrite(hbMap[motor].poleB[j], state, tle94112.TLE_NOPWM);
+}
+
+void MotorControl::motorConfigHBCW(int motor) {
+  motorConfigPoles(motor, hbMap[motor].poleB, hbMap[motor].poleA);
+}
+
 void MotorControl::motorConfigHBCCW(int motor) {
-  int hb1;
+  motorConfigPoles(motor, hbMap[motor].poleA, hbMap[motor].poleB);
+}
 
-  // Calculate the first half bridge depending on the motor ID
-  // Note that HB are numbered base 1 while motor is index array base 0
-  // and HB usage is different if high current mode is selected in the
-  // preprocessor directive
-  hb1 = calcHB1(motor + 1);
+void MotorControl::motorConfigPoles(int motor, const Tle94112::HalfBridge* low, const Tle94112::HalfBridge* high) {
+  int j;
+  uint8_t fw;
+
+  fw = (uint8_t)internalStatus[motor].freeWheeling;
 
-  // Set motor stopped
+  // Set motor running
+  if(!internalStatus[motor].isRunning)
+    runStart[motor] = millis();
   internalStatus[motor].isRunning = true;
-  
-  // Select the half bridges to configure the motor.
-  // Depending on the mode (normal = 1 + 1 HB per motor, high current = 2+2)
-  // not all the half bridges can be the first (=hb1)
-  switch(hb1) {
-    // -------------------------------------------------
-    // Motor 1 (in both modes)
-    // -------------------------------------------------
-    case 1:
-      tle94112.configHB(tle94112.TLE_HB1, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB3,  tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB2, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 2 (no high current mode)
-    // -------------------------------------------------
-    case 3: 
-      tle94112.configHB(tle94112.TLE_HB3, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB4, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 3 (Motor 2 in high current mode)
-    // -------------------------------------------------
-    case 5: 
-      tle94112.configHB(tle94112.TLE_HB5, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #else
-          tle94112.configHB(tle94112.TLE_HB6, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 4 (no high current mode)
-    // -------------------------------------------------
-    case 7:  
-      tle94112.configHB(tle94112.TLE_HB7, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB8, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // // Motor 5 ((Motor 3 in high current mode)
-    // -------------------------------------------------
-    case 9: 
-      tle94112.configHB(tle94112.TLE_HB9, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #ifdef _HIGHCURRENT
-      tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      #endif
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling );
-          #else
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM1:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling );
-          #else
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM2:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling );
-          #else
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-        case tle94112.TLE_PWM3:
-          #ifdef _HIGHCURRENT
-          tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling );
-          #else
-          tle94112.configHB(tle94112.TLE_HB10, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling );
-          #endif
-        break;
-      }
-    break;
-    // -------------------------------------------------
-    // Motor 6 (no high current mode)
-    // -------------------------------------------------
-    case 11: 
-      tle94112.configHB(tle94112.TLE_HB11, tle94112.TLE_LOW, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-      switch(internalStatus[motor].channelPWM){
-        case tle94112.TLE_NOPWM:
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_NOPWM, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM1:
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM1, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM2:
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM2, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-        case tle94112.TLE_PWM3:
-          tle94112.configHB(tle94112.TLE_HB12, tle94112.TLE_HIGH, tle94112.TLE_PWM3, (uint8_t)internalStatus[motor].freeWheeling);
-        break;
-      }
-    break;
-  }
+  braked[motor] = false;
+
+  // The low pole is set first, then the high pole with the PWM channel
+  for(j = 0; j < hbMap[motor].numHB; j++)
+    hbWrite(low[j], tle94112.TLE_LOW, tle94112.TLE_NOPWM, fw);
+  for(j = 0; j < hbMap[motor].numHB; j++)
+    hbWrite(high[j], tle94112.TLE_HIGH, (Tle94112::PWMChannel)internalStatus[motor].channelPWM, fw);
 }
 
 // ===============================================================
@@ -836,7 +714,7 @@ void MotorControl::motorConfigHBCCW(int motor) {
 // ===============================================================
 
 boolean MotorControl:: tleCheckDiagnostic(void) {
-  if(tle94112.getSysDiagnosis() == tle94112.TLE_STATUS_OK)
+  if(readDiagnosis() == tle94112.TLE_STATUS_OK)
     return false;
   else
     return true;
@@ -849,184 +727,263 @@ void MotorControl::tleDiagnostic(int motor, String message) {
 }
 
 void MotorControl::tleDiagnostic(int motor) {
-  int diagnosis = tle94112.getSysDiagnosis();
+  int diagnosis = readDiagnosis();
 
   if(diagnosis == tle94112.TLE_STATUS_OK) {
-    Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_NOERROR << endl;
+    CONSOLE_LOG(LOG_DEBUG) << diagnosticHeader << " Motor " << motor << " - " << TLE_NOERROR << endl;
   } // No errors
   else {
+    stats.faults(diagnosis);
     #ifndef _IGNORE_OPENLOAD
-    if(tle94112.getSysDiagnosis(tle94112.TLE_LOAD_ERROR) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_LOADERROR << endl;
+    if(readDiagnosis(tle94112.TLE_LOAD_ERROR) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_LOADERROR << endl;
     } // Open load error
     #endif
-    if(tle94112.getSysDiagnosis(tle94112.TLE_SPI_ERROR) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_SPIERROR << endl;
+    if(readDiagnosis(tle94112.TLE_SPI_ERROR) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_SPIERROR << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_UNDER_VOLTAGE) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_UNDERVOLTAGE << endl;
+    if(readDiagnosis(tle94112.TLE_UNDER_VOLTAGE) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_UNDERVOLTAGE << endl;
+      underVoltages++;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_OVER_VOLTAGE) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial <<TLE_OVERVOLTAGE << endl;
+    if(readDiagnosis(tle94112.TLE_OVER_VOLTAGE) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) <<TLE_OVERVOLTAGE << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_POWER_ON_RESET) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_POWERONRESET << endl;
+    if(readDiagnosis(tle94112.TLE_POWER_ON_RESET) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_POWERONRESET << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_TEMP_SHUTDOWN) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_TEMPSHUTDOWN << endl;
+    if(readDiagnosis(tle94112.TLE_TEMP_SHUTDOWN) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_TEMPSHUTDOWN << endl;
+      tempShutdowns++;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_TEMP_WARNING) != 0) {
-      Serial << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
-      Serial << TLE_TEMPWARNING;
+    if(readDiagnosis(tle94112.TLE_TEMP_WARNING) != 0) {
+      CONSOLE_LOG(LOG_WARNING) << diagnosticHeader << " Motor " << motor << " - " << TLE_ERROR_MSG << endl;
+      CONSOLE_LOG(LOG_WARNING) << TLE_TEMPWARNING << endl;
+      tempWarnings++;
     }
-    // Clear all possible error conditions        
-    tle94112.clearErrors();
+    // A chip reset or a SPI fault lose the configuration, else
+    // clear all possible error conditions
+    if(readDiagnosis(TLE_RECOVERY_FLAGS) != 0)
+      tleRecover();
+    else
+      clearDiagnosis();
     diagnosticHeader = "";
   } // Error condition
 }
 
 void MotorControl::tleDiagnostic() {
-  int diagnosis = tle94112.getSysDiagnosis();
+  int diagnosis = readDiagnosis();
 
   if(diagnosis == tle94112.TLE_STATUS_OK) {
-    Serial << diagnosticHeader << TLE_NOERROR << endl;
+    CONSOLE_LOG(LOG_DEBUG) << diagnosticHeader << TLE_NOERROR << endl;
   } // No errors
   else {
+    stats.faults(diagnosis);
     diagnosticHeader += TLE_ERROR_MSG;
     #ifndef _IGNORE_OPENLOAD
-    if(tle94112.getSysDiagnosis(tle94112.TLE_LOAD_ERROR) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_LOADERROR << endl;
+    if(readDiagnosis(tle94112.TLE_LOAD_ERROR) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_LOADERROR << endl;
     } // Open load error
     #endif
-    if(tle94112.getSysDiagnosis(tle94112.TLE_SPI_ERROR) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_SPIERROR << endl;
+    if(readDiagnosis(tle94112.TLE_SPI_ERROR) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_SPIERROR << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_UNDER_VOLTAGE) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_UNDERVOLTAGE << endl;
+    if(readDiagnosis(tle94112.TLE_UNDER_VOLTAGE) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_UNDERVOLTAGE << endl;
+      underVoltages++;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_OVER_VOLTAGE) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial <<TLE_OVERVOLTAGE << endl;
+    if(readDiagnosis(tle94112.TLE_OVER_VOLTAGE) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) <<TLE_OVERVOLTAGE << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_POWER_ON_RESET) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_POWERONRESET << endl;
+    if(readDiagnosis(tle94112.TLE_POWER_ON_RESET) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_POWERONRESET << endl;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_TEMP_SHUTDOWN) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_TEMPSHUTDOWN << endl;
+    if(readDiagnosis(tle94112.TLE_TEMP_SHUTDOWN) != 0) {
+      CONSOLE_LOG(LOG_ERROR) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_ERROR) << TLE_TEMPSHUTDOWN << endl;
+      tempShutdowns++;
     }
-    if(tle94112.getSysDiagnosis(tle94112.TLE_TEMP_WARNING) != 0) {
-      Serial << diagnosticHeader << endl;
-      Serial << TLE_TEMPWARNING;
+    if(readDiagnosis(tle94112.TLE_TEMP_WARNING) != 0) {
+      CONSOLE_LOG(LOG_WARNING) << diagnosticHeader << endl;
+      CONSOLE_LOG(LOG_WARNING) << TLE_TEMPWARNING << endl;
+      tempWarnings++;
     }
-    // Clear all possible error conditions        
-    tle94112.clearErrors();
+    // A chip reset or a SPI fault lose the configuration, else
+    // clear all possible error conditions
+    if(readDiagnosis(TLE_RECOVERY_FLAGS) != 0)
+      tleRecover();
+    else
+      clearDiagnosis();
     diagnosticHeader = " ";
   } // Error condition
 }
 
+void MotorControl::tleHealthCheck(void) {
+  if(readDiagnosis(TLE_RECOVERY_FLAGS | tle94112.TLE_TEMP_WARNING | tle94112.TLE_TEMP_SHUTDOWN) != 0)
+    tleDiagnostic();
+}
+
+boolean MotorControl::tleRecover(void) {
+  int attempt;
+  unsigned long start;
+
+  if(recovering)
+    return false;
+  recovering = true;
+
+  start = millis();
+  for(attempt = 0; (attempt < TLE_RECOVERY_RETRIES) && ((millis() - start) < TLE_RECOVERY_MS); attempt++) {
+    // After a SPI fault the interface is initialised again
+    if(readDiagnosis(tle94112.TLE_SPI_ERROR) != 0) {
+      tle94112.end();
+      tle94112.begin();
+    }
+    clearDiagnosis();
+
+    // Apply the cached configuration then resume the motors that were running
+    resetHB();
+    resumeHB();
+
+    if(readDiagnosis(TLE_RECOVERY_FLAGS) == 0) {
+      recoveries++;
+      CONSOLE_LOG(LOG_WARNING) << TLE_RECOVERED << (attempt + 1) << endl;
+      recovering = false;
+      return true;
+    }
+  }
+
+  recoveryFailures++;
+  CONSOLE_LOG(LOG_ERROR) << TLE_RECOVERY_FAILED << endl;
+  recovering = false;
+
+  return false;
+}
+
 // ===============================================================
 // Dump system configuration to serial
 // ===============================================================
 
 void MotorControl::showInfo(void) {
   int j;
+  Print &out = console.bulk();
+
   // Motor table header
-  Serial << INFO_MAIN_HEADER1 << endl << INFO_MOTORS_TITLE << endl << INFO_MAIN_HEADER1 << endl;
-  Serial << INfO_TAB_HEADER2 << endl << INfO_TAB_HEADER1 << endl << INfO_TAB_HEADER2 << endl;
+  out << INFO_MAIN_HEADER1 << endl << INFO_MOTORS_TITLE << endl << INFO_MAIN_HEADER1 << endl;
+  out << INfO_TAB_HEADER2 << endl << INfO_TAB_HEADER1 << endl << INfO_TAB_HEADER2 << endl;
   // Build the motors settings table data
   for (j = 0; j < MAX_MOTORS; j++) {
     // #1 - Motor
-    Serial << INFO_FIELD1A << (j + 1) << INFO_FIELD1B;
+    out << INFO_FIELD1A << (j + 1) << INFO_FIELD1B;
     // #2 - Enabled
     if(internalStatus[j].isEnabled)
-      Serial << INFO_FIELD2Y;
+      out << INFO_FIELD2Y;
     else
-      Serial << INFO_FIELD2N;
+      out << INFO_FIELD2N;
     // #3 - Active freewheeling
     if(internalStatus[j].freeWheeling)
-      Serial << INFO_FIELD4Y;
+      out << INFO_FIELD4Y;
     else
-      Serial << INFO_FIELD4N;
+      out << INFO_FIELD4N;
     // #4 - Direction
     if(internalStatus[j].motorDirection == MOTOR_DIRECTION_CW)
-      Serial << INFO_FIELD8A;
+      out << INFO_FIELD8A;
     else
-      Serial << INFO_FIELD8B;
+      out << INFO_FIELD8B;
     // #5 - PWM
-    switch(internalStatus[j].channelPWM) {
-      case tle94112.TLE_NOPWM:
-        Serial << INFO_FIELD9_NO;
-      break;
-      case tle94112.TLE_PWM1:
-        Serial << INFO_FIELD9_80;
-      break;
-      case tle94112.TLE_PWM2:
-        Serial << INFO_FIELD9_100;
-      break;
-      case tle94112.TLE_PWM3:
-        Serial << INFO_FIELD9_200;
-      break;
-    }
-    Serial << endl << INfO_TAB_HEADER2 << endl;
+    if(internalStatus[j].channelPWM == tle94112.TLE_NOPWM)
+      out << INFO_FIELD9_NO;
+    else
+      showPWMFrequency(out, dutyCyclePWM[internalStatus[j].channelPWM - 1].freq, true);
+    // #6 - Half bridges per pole
+    if(hbMap[j].numHB == 0)
+      out << INFO_FIELD11_NO;
+    else
+      out << INFO_FIELD11A << hbMap[j].numHB << INFO_FIELD11B;
+    out << endl << INfO_TAB_HEADER2 << endl;
   }
 
   // PWM table header
-  Serial << endl << INFO_MAIN_HEADER2 << endl << INFO_PWM_TITLE << endl << INFO_MAIN_HEADER2 << endl;
-  Serial << INfO_TAB_HEADER4 << endl << INfO_TAB_HEADER3 << endl << INfO_TAB_HEADER4 << endl;
+  out << endl << INFO_MAIN_HEADER2 << endl << INFO_PWM_TITLE << endl << INFO_MAIN_HEADER2 << endl;
+  out << INfO_TAB_HEADER4 << endl << INfO_TAB_HEADER3 << endl << INfO_TAB_HEADER4 << endl;
   // Build the pwm settings table data
   for (j = 0; j < AVAIL_PWM_CHANNELS; j++) {
     // #1 - PWM
-    switch(j) {
-      case 0:
-        Serial << INFO_FIELD10_80;
-      break;
-      case 1:
-        Serial << INFO_FIELD10_100;
-      break;
-      case 2:
-        Serial << INFO_FIELD10_200;
-      break;
-    }
+    showPWMFrequency(out, dutyCyclePWM[j].freq, false);
     // #2 - DC Min
-    Serial << INFO_FIELD5_6A;
+    out << INFO_FIELD5_6A;
     if(dutyCyclePWM[j].minDC < 10)
-      Serial << "  ";
+      out << "  ";
     else 
       if(dutyCyclePWM[j].minDC < 100)
-        Serial << " ";
-    Serial << dutyCyclePWM[j].minDC << INFO_FIELD5_6B;
+        out << " ";
+    out << dutyCyclePWM[j].minDC << INFO_FIELD5_6B;
     // #3 - DC Max
-    Serial << INFO_FIELD5_6A;
+    out << INFO_FIELD5_6A;
     if(dutyCyclePWM[j].maxDC < 100)
-      Serial << " ";
-    Serial << dutyCyclePWM[j].maxDC << INFO_FIELD5_6B;
+      out << " ";
+    out << dutyCyclePWM[j].maxDC << INFO_FIELD5_6B;
     // #4 - Manual DC
     if(dutyCyclePWM[j].manDC)
-      Serial << INFO_FIELD7Y;
+      out << INFO_FIELD7Y;
     else
-      Serial << INFO_FIELD7N;
+      out << INFO_FIELD7N;
     // #5 - Acceleration
     if(dutyCyclePWM[j].useRamp)
-      Serial << INFO_FIELD3Y;
+      out << INFO_FIELD3Y;
     else
-      Serial << INFO_FIELD3N;
+      out << INFO_FIELD3N;
     
-    Serial << endl << INfO_TAB_HEADER4 << endl;
+    out << endl << INfO_TAB_HEADER4 << endl;
   }
-}
-
-
-
 
+  out << INFO_RECOVERIES << recoveries << INFO_RECOVERY_FAILED << recoveryFailures << endl;
+  out << INFO_STOP_MODE;
+  for(j = 0; j < MAX_MOTORS; j++) {
+    out << INFO_FIELD1A << (j + 1);
+    switch(internalStatus[j].stopMode) {
+      case MOTOR_STOP_COAST:
+        out << INFO_STOP_COAST;
+      break;
+      case MOTOR_STOP_BRAKE:
+        out << INFO_STOP_BRAKE;
+      break;
+      case MOTOR_STOP_TIMED:
+        out << INFO_STOP_TIMED << internalStatus[j].brakeMs;
+      break;
+    }
+  }
+  out << endl;
+  out << INFO_STAGGER << staggerUs << INFO_BUDGET << startBudget << INFO_START_TIME << lastStartTime <<
+    INFO_START_UV << lastStartEvents << "/" << underVoltages << endl;
+}
 
+void MotorControl::showPWMFrequency(Print &out, uint8_t freq, boolean shortField) {
+  switch(freq) {
+    case Tle94112::TLE_FREQ80HZ:
+      out << (shortField ? INFO_FIELD9_80 : INFO_FIELD10_80);
+    break;
+    case Tle94112::TLE_FREQ100HZ:
+      out << (shortField ? INFO_FIELD9_100 : INFO_FIELD10_100);
+    break;
+    case Tle94112::TLE_FREQ200HZ:
+      out << (shortField ? INFO_FIELD9_200 : INFO_FIELD10_200);
+    break;
+    case Tle94112::TLE_FREQ2KHZ:
+      out << (shortField ? INFO_FIELD9_2K : INFO_FIELD10_2K);
+    break;
+    default:
+      out << (shortField ? INFO_FIELD9_NO : INFO_FIELD10_NO);
+    break;
+  }
+}
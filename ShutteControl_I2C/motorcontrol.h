@@ -15,6 +15,7 @@
 #include <Streaming.h>
 #include <TLE94112.h>
 #include "motor.h"
+#include "console.h"
 
 /**
  * All the state flas and value settings for a generic motor
@@ -25,6 +26,20 @@ struct motorStatus {
   boolean isRunning;      ///< Motor running status (should be enabled)
   boolean freeWheeling;   ///< Free wheeling active or passive
   int motorDirection;     ///< Current motor direction
+  uint8_t currentClass;   ///< Half bridges per pole, MOTOR_CURRENT_NORMAL or MOTOR_CURRENT_HIGH
+  uint8_t stopMode;       ///< MOTOR_STOP_COAST, MOTOR_STOP_BRAKE or MOTOR_STOP_TIMED
+  unsigned int brakeMs;   ///< Brake time (ms) of the timed brake stop
+};
+
+/**
+ * Half bridges connected to the two poles of a motor.
+ * When the motor runs clockwise pole A is high and pole B is low,
+ * counterclockwise the opposite
+ */
+struct motorHB {
+  uint8_t numHB;                                ///< Half bridges per pole, 0 if not allocated
+  Tle94112::HalfBridge poleA[MAX_HB_PER_POLE];  ///< Half bridges of the first pole
+  Tle94112::HalfBridge poleB[MAX_HB_PER_POLE];  ///< Half bridges of the second pole
 };
 
 /**
@@ -36,23 +51,31 @@ struct pwmStatus {
   uint8_t minDC;          ///< Min duty cycle value
   uint8_t maxDC;          ///< Max duty cycle value
   boolean manDC;          ///< Manual duty cycle flag
+  uint8_t freq;           ///< Frequency bound to the channel (Tle94112::PWMFreq)
+  uint8_t curDC;          ///< Duty cycle currently written to the channel
+};
+
+/**
+ * Motors and PWM configuration saved in a profile. The runtime
+ * fields (running status, current duty cycle) are not restored
+ */
+struct motorProfile {
+  motorStatus motors[MAX_MOTORS];           ///< Motors settings
+  pwmStatus pwm[AVAIL_PWM_CHANNELS];        ///< PWM channels settings
 };
 
 /**
  * \brief  Class to control the TLE94112 Arduino shield
  * 
- * The class control three PWM channels and two ranges of motors.
- * If _HIGH_CURRENT is defined are used two half bridges every motor pole
- * so only 3 max motors are allowed else 6 motors can be managed
+ * The class control three PWM channels and up to 6 motors.
+ * Every motor has its own current class, fixed by the wiring: high current
+ * motors use two half bridges every pole, normal motors one. The half bridges
+ * are allocated on initialisation in the motors order until all the 12 are used.
  * 
- * In this class we define an hardcoded assumption presetting the three PWM 
- * frequencies associated by default to the three channels. 
- * A different frequency can be associated
- * to every motor selecting the corresponding PWM channel ID.\n
- * With this choice we loose the option to assgin the same frequency to two
- * different PWM channels and different duty cycles but it a meaningless
- * limitation that can be considered acceptable considering the flexibility
- * of the entire class.
+ * The three PWM channels are bound by default to 80, 100 and 200 Hz. 
+ * The binding can be changed at runtime, and the motors can request a
+ * frequency and duty cycle: the motors with the same settings share a
+ * channel, else a free channel is bound to the requested settings.
  */
 class MotorControl {
   public:
@@ -63,37 +86,115 @@ class MotorControl {
     int currentPWM;
     //! Status of the motors parameters and settings
     motorStatus internalStatus[MAX_MOTORS];
+    //! Half bridges allocated to the motors
+    motorHB hbMap[MAX_MOTORS];
+    //! Number of motors with half bridges allocated
+    int numMotors;
     //! Status of the PWM duty cycle
     pwmStatus dutyCyclePWM[AVAIL_PWM_CHANNELS];
     //! Compound diagnostic string. Used when motor number is available
     String diagnosticHeader;
     //! The last duty cycle value read from the analog input (manual duty cycle settings)
     uint8_t lastAnalogDC;
-    //! The previous duty cycle value read from the analog input (manual duty cycle settings)
-    uint8_t prevAnalogDC;
+    //! Time of the last manual duty cycle step (millis)
+    unsigned long lastAnalogStep;
     //! Global flag is one (or more) of the PWM channels are set to manualDC
     boolean hasManualDC;
+    //! Number of successful TLE94112 recoveries
+    unsigned int recoveries;
+    //! Number of TLE94112 recoveries failed within the retry budget
+    unsigned int recoveryFailures;
+    //! Number of TLE94112 temperature warnings
+    unsigned int tempWarnings;
+    //! Number of TLE94112 temperature shutdowns
+    unsigned int tempShutdowns;
+    //! Total running time of every motor (ms)
+    unsigned long onTime[MAX_MOTORS];
+    //! Start time of the current run of every motor (millis)
+    unsigned long runStart[MAX_MOTORS];
+    //! Percentage of the duty cycle actually written to the PWM channels (thermal limit)
+    uint8_t dcLimit;
+    //! Delay (us) between two groups of motors on start
+    unsigned int staggerUs;
+    //! Sum of the current classes of the motors energised together on start
+    uint8_t startBudget;
+    //! Number of TLE94112 under voltage events
+    unsigned int underVoltages;
+    //! Under voltage events during the last start of all the motors
+    unsigned int lastStartEvents;
+    //! Duration (us) of the last start of all the motors
+    unsigned long lastStartTime;
+    //! Motors braked by a timed brake stop, waiting to be released
+    boolean braking[MAX_MOTORS];
+    //! Time (millis) of the timed brake stop of every motor
+    unsigned long brakeStart[MAX_MOTORS];
+    //! Motors whose poles are held low by a brake stop
+    boolean braked[MAX_MOTORS];
 
     /** 
      * \brief Initialization and motor settings 
      * 
-     * The initialization method support two hardcoded modes, depending on the
-     * kind of geared motor it is used.\n
-     * In _HIGHCURRENT mode every motor uses two half bridges couple together for every 
+     * The motors current class is set to MOTOR_CURRENT_WIRING.\n
+     * High current motors use two half bridges couple together for every 
      * pole if more than 0.9A is needed (< 0.18)\n
-     * The standard usage mode is in low current mode with a single half bridge every motor pole
+     * The normal current motors use a single half bridge every motor pole
+     * 
+     * If a profile is passed it replaces the default settings before
+     * the configuration is written to the TLE94112, so the boot
+     * configuration is applied in a single pass.
+     * 
+     * \param profile The boot configuration, NULL for the defaults
      */
-    void begin(void);
+    void begin(const motorProfile* profile = NULL);
 
     //! \brief stop the motor control
     void end(void);
 
+    /**
+     * \brief Enable again the TLE94112 after end() and apply the cached
+     * configuration without resetting the settings to the defaults
+     * 
+     * The PWM channels are configured again with their bound frequency and
+     * the last duty cycle, then the running motors are driven again and the
+     * brakes held when the control was stopped are applied again.
+     */
+    void restore(void);
+
+    //! \brief A motor is running or its timed brake is not released
+    boolean isBusy(void);
+
     /**
      * \brief initialize the motor default settings and disable all the motors
      * Launched when the class is initialised.
      */
     void reset(void);
 
+    /**
+     * \brief Set the default settings without changing the TLE94112 configuration
+     */
+    void setDefaults(void);
+
+    /**
+     * \brief Allocate the half bridges and write the current settings to the
+     * TLE94112 with all the motors stopped
+     */
+    void apply(void);
+
+    /**
+     * \brief Copy the current settings to a profile
+     * 
+     * \param profile The profile to fill
+     */
+    void getProfile(motorProfile &profile);
+
+    /**
+     * \brief Replace the current settings with a profile. The settings are
+     * written to the TLE94112 by apply()
+     * 
+     * \param profile The profile to copy
+     */
+    void setProfile(const motorProfile &profile);
+
     /**
      * \brief Reset all the half bridges immediately stopping the motors
      */
@@ -123,6 +224,12 @@ class MotorControl {
       */
     void setMotorDirection(int dir);
 
+    /**
+     * \brief Allocate the half bridges to the motors depending on their
+     * current class, in the motors order
+     */
+    void allocateHB(void);
+
     /**
      * \brief Enable or disable the acceleration/deceleration sequence
      * for the desired PWM channel
@@ -131,11 +238,119 @@ class MotorControl {
      */
     void setPWMRamp(boolean acc);
 
+    /**
+     * \brief Write the duty cycle to a PWM channel with its bound frequency
+     * 
+     * \param channel the selected PWM channel (base 0)
+     * \param dc The duty cycle
+     */
+    void pwmWrite(int channel, uint8_t dc);
+
+    /**
+     * \brief Set the percentage of the duty cycle written to the PWM channels
+     * and apply it immediately to the running channels
+     * 
+     * \param limit The duty cycle limit (%)
+     */
+    void setDCLimit(uint8_t limit);
+
+    /**
+     * \brief Total running time of a motor, the current run included
+     * 
+     * \param motor The motor ID (base 0)
+     * \return The running time (ms)
+     */
+    unsigned long runningTime(int motor);
+
+    /**
+     * \brief Write the configuration of a half bridge. All the half bridges
+     * writes go through this method so they can be traced
+     * 
+     * \param hb The half bridge
+     * \param state The half bridge state
+     * \param pwm The PWM channel
+     */
+    void hbWrite(Tle94112::HalfBridge hb, Tle94112::HBState state, Tle94112::PWMChannel pwm);
+
+    /**
+     * \brief Write the configuration of a half bridge with the freewheeling mode
+     * 
+     * \param hb The half bridge
+     * \param state The half bridge state
+     * \param pwm The PWM channel
+     * \param fw Active freewheeling flag
+     */
+    void hbWrite(Tle94112::HalfBridge hb, Tle94112::HBState state, Tle94112::PWMChannel pwm, uint8_t fw);
+
+    /**
+     * \brief Read the TLE94112 system diagnosis. All the SPI transactions
+     * go through the write and diagnosis methods so they can be counted
+     * 
+     * \return The diagnosis, TLE_STATUS_OK if there are no errors
+     */
+    uint8_t readDiagnosis(void);
+
+    /**
+     * \brief Read the selected flags of the TLE94112 system diagnosis
+     * 
+     * \param flags The diagnostic flags mask
+     * \return The flags set
+     */
+    uint8_t readDiagnosis(uint8_t flags);
+
+    //! \brief Clear the TLE94112 error conditions
+    void clearDiagnosis(void);
+
+    /**
+     * \brief Check if a PWM channel is assigned to some motor
+     * 
+     * \param channel the PWM channel (base 0)
+     * \param exclude Motor ID (base 0) not considered in the check, -1 for none
+     * \return true if the channel is in use
+     */
+    boolean isPWMUsed(int channel, int exclude);
+
+    /**
+     * \brief Bind a frequency to the selected PWM channel (or all)
+     *
+     * \param freq The frequency, one of the Tle94112::PWMFreq values
+     */
+    void setPWMFrequency(uint8_t freq);
+
+    /**
+     * \brief Assign to the current motor a PWM channel with the requested
+     * frequency and duty cycle
+     *
+     * A channel already bound to the same frequency and max duty cycle is
+     * shared, else a channel not used by other motors is bound to the
+     * requested settings.
+     *
+     * \param freq The frequency, one of the Tle94112::PWMFreq values
+     * \param dc The max duty cycle
+     * \return false if no channel is available
+     */
+    boolean requestPWM(uint8_t freq, uint8_t dc);
+
+    /**
+     * \brief Convert a frequency in Hz to the corresponding TLE94112 setting
+     *
+     * \param hz The frequency in Hz (0, 80, 100, 200 or 2000)
+     * \return The Tle94112::PWMFreq value or -1 if the frequency is not supported
+     */
+    int pwmFrequencyCode(long hz);
+
     /**
      * \brief Start PWM channels
      */
     void motorPWMStart(void);
 
+    /**
+     * \brief Start a PWM channel with its acceleration cycle if any
+     * 
+     * \param channel the selected PWM channel (base 0)
+     */
+    void motorPWMStart(int channel);
+
     /**
      * \brief Start PWM channels
      */
@@ -156,8 +371,11 @@ class MotorControl {
     void motorPWMDecelerate(int channel);
 
     /**
-     * \brief Change the current duty cicle value through acceleration/deceleration
-     * for the PWM channels that has set the manual duty cycle
+     * \brief Move the duty cycle of the PWM channels set to manual duty cycle
+     * toward lastAnalogDC
+     * 
+     * The method should be called every loop: it does not block, at most
+     * every ANALOG_DC_STEP_MS the duty cycle is changed by ANALOG_DC_STEP
      */
     void motorPWMAnalogDC(void);
 
@@ -182,6 +400,21 @@ class MotorControl {
      */
     void setMotorFreeWheeling(boolean fw);
 
+    /**
+     * \brief Set the stop mode of the current motor, all the motors if
+     * no motor is selected
+     * 
+     * \param mode MOTOR_STOP_COAST, MOTOR_STOP_BRAKE or MOTOR_STOP_TIMED
+     * \param ms The brake time of the timed brake stop
+     */
+    void setMotorStopMode(uint8_t mode, unsigned int ms);
+
+    /**
+     * \brief Release the motors whose timed brake is expired setting their
+     * half bridges floating. Should be called periodically by the main loop
+     */
+    void motorBrakeRelease(void);
+
     /**
      * \brief Set the state flag for duty cycle mode. 
      * 
@@ -218,9 +451,20 @@ class MotorControl {
 
     /**
      * \brief Start all enabled motors
+     * 
+     * The motors are staggered to limit the inrush current, see motorConfigHB().
+     * The duration and the under voltage events of the start are recorded.
      */
     void startMotors();
 
+    /**
+     * \brief Set the staggered start parameters
+     * 
+     * \param us Delay (us) between two groups of motors
+     * \param budget Max sum of the current classes of a group
+     */
+    void setStartStagger(unsigned int us, uint8_t budget);
+
     /**
      * \brief Stop all running motors
      */
@@ -247,6 +491,11 @@ class MotorControl {
      * The method loop on all motors and call recursively the same
      * polymorphic method that exectues the real setup for the motor
      * based on the direction.
+     * 
+     * The motors are started in groups whose current classes sum does not
+     * exceed startBudget, waiting staggerUs between the groups. There is no
+     * wait after the last group. The PWM channel of a motor is started with
+     * its group, then the channels not used by any started motor.
      */
     void motorConfigHB(void);
 
@@ -282,6 +531,16 @@ class MotorControl {
      */
     void motorConfigHBCCW(int motor);
 
+    /**
+     * \brief Configure the halfbridges of the motor poles setting one pole low
+     * and the other pole high with the motor PWM channel
+     * 
+     * \param motor The motor ID to be configured (base 0)
+     * \param low The half bridges of the low pole
+     * \param high The half bridges of the high pole
+     */
+    void motorConfigPoles(int motor, const Tle94112::HalfBridge* low, const Tle94112::HalfBridge* high);
+
     /*
      * \brief Stop all running motors
      * 
@@ -293,17 +552,37 @@ class MotorControl {
     /*
      * \brief Stop the specified motor
      * 
-     * This method stops immediately the selected motor resetting the half bridges
-     * and deactivating the PWM if active
+     * This method stops immediately the selected motor according with its stop
+     * mode: the half bridges are set floating and the motor coasts, or both
+     * the poles are set low braking the motor. The timed brake is released
+     * by motorBrakeRelease()
      */
     void motorStopHB(int motor);
 
+    /**
+     * \brief Write the same state without PWM to the half bridges of both
+     * the poles of a motor, pole A first, as the stop sequence
+     * 
+     * \param motor The motor ID (base 0)
+     * \param state The half bridges state
+     */
+    void motorPolesWrite(int motor, Tle94112::HBState state);
+
     /** 
      * \brief Show Current motors configuration in a table and the PWM settings on
      * another to the serial terminal
      */
      void showInfo(void);
 
+    /**
+     * \brief Show a PWM frequency in the configuration tables
+     * 
+     * \param out The output
+     * \param freq The frequency, one of the Tle94112::PWMFreq values
+     * \param shortField true for the motors table field, false for the PWM table
+     */
+     void showPWMFrequency(Print &out, uint8_t freq, boolean shortField);
+
     /**
      * Check if an error occured.
      * 
@@ -336,6 +615,33 @@ class MotorControl {
      */
     void tleDiagnostic(int motor, String message);
 
+    /**
+     * \brief Check if the TLE94112 has been reset, has a SPI fault or is
+     * too hot. The chip is recovered and the temperature events are counted.
+     * Should be called periodically by the main loop
+     */
+    void tleHealthCheck(void);
+
+    /**
+     * \brief Recover the TLE94112 after a power on reset or a SPI fault
+     * 
+     * The cached configuration is written again and the motors that were running
+     * are restarted, retrying up to TLE_RECOVERY_RETRIES times within TLE_RECOVERY_MS.
+     * 
+     * \return true if the chip has been recovered
+     */
+    boolean tleRecover(void);
+
+  private:
+    //! A recovery is in progress, avoid nested recoveries from the diagnostic
+    boolean recovering;
+
+    /**
+     * \brief Write the cached PWM duty cycles, then drive again the running
+     * motors and the held brakes after the half bridges have been reset
+     */
+    void resumeHB(void);
+
 };
 
 #endif
@@ -0,0 +1,27 @@
+/**
+ *  \file power.cpp
+ *  \brief This file defines functions and predefined instances from power.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "power.h"
+
+void PowerManager::resumed(unsigned long us) {
+  wakeups++;
+  lastResume = us;
+  if(us > maxResume)
+    maxResume = us;
+
+  if(us > IDLE_RESUME_MAX_US)
+    CONSOLE_LOG(LOG_WARNING) << PWR_MSG_WAKE << us << PWR_MSG_SLOW << endl;
+  else
+    CONSOLE_LOG(LOG_DEBUG) << PWR_MSG_WAKE << us << endl;
+
+  activity();
+}
+
+void PowerManager::showInfo(void) {
+  CONSOLE_LOG(LOG_INFO) << PWR_MSG_TITLE << timeout << PWR_MSG_WAKEUPS << wakeups <<
+    PWR_MSG_RESUME << lastResume << "/" << maxResume << endl;
+}
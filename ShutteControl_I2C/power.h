@@ -0,0 +1,96 @@
+/**
+ *  \file power.h
+ *  \brief Idle policy: low power mode when no commands are received
+ *
+ *  After the idle timeout without activity the main loop puts the TLE94112
+ *  in sleep mode and the MCU waits for interrupts. The serial and I2C
+ *  receive interrupts, the trigger input and the system tick wake the MCU
+ *  that checks if there is something to do, else goes back to sleep.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _POWER
+#define _POWER
+
+#include <Streaming.h>
+#include "console.h"
+
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
+//! Default idle timeout (ms), 0 disables the low power mode
+#define IDLE_TIMEOUT_DEFAULT 60000
+//! Max expected time (us) to restore the motor control after wake up.
+//! Longer resumes are reported as a warning
+#define IDLE_RESUME_MAX_US 2000
+
+#define PWR_MSG_SLEEP "Sleep"
+#define PWR_MSG_WAKE "Wake "
+#define PWR_MSG_SLOW " slow resume"
+#define PWR_MSG_TITLE "Idle timeout (ms) "
+#define PWR_MSG_WAKEUPS " wakeups "
+#define PWR_MSG_RESUME " resume (us) "
+
+/**
+ * \brief Idle timer and low power mode statistics
+ *
+ * The class only decides when the system is idle and puts the core
+ * in sleep: the main loop stops and restores the peripherals.
+ */
+class PowerManager {
+  public:
+
+    //! Idle time (ms) before entering the low power mode, 0 = disabled
+    unsigned long timeout = IDLE_TIMEOUT_DEFAULT;
+    //! Number of wake ups from the low power mode
+    unsigned int wakeups = 0;
+    //! Duration (us) of the last restore after wake up
+    unsigned long lastResume = 0;
+    //! Longest restore (us) after wake up
+    unsigned long maxResume = 0;
+
+    //! \brief Restart the idle timer. Should be called on every command or shot
+    void activity(void) {
+      lastActivity = millis();
+    }
+
+    /**
+     * \brief Check if the idle timeout has expired
+     *
+     * \return true if the system should enter the low power mode
+     */
+    boolean isIdle(void) {
+      return (timeout != 0) && ((millis() - lastActivity) >= timeout);
+    }
+
+    /**
+     * \brief Halt the core until the next interrupt. The peripherals
+     * are still running so any interrupt wakes up the core
+     */
+    void cpuSleep(void) {
+#if defined(__AVR__)
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_mode();
+#else
+      __WFI();
+#endif
+    }
+
+    /**
+     * \brief Account a wake up and the time needed to restore the system
+     *
+     * \param us The restore duration in microseconds
+     */
+    void resumed(unsigned long us);
+
+    //! \brief Show the idle settings and the wake up statistics
+    void showInfo(void);
+
+  private:
+    //! Time of the last activity (millis)
+    unsigned long lastActivity = 0;
+};
+
+#endif
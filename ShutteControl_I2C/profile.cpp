@@ -0,0 +1,91 @@
+/**
+ *  \file profile.cpp
+ *  \brief This file defines functions and predefined instances from profile.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "profile.h"
+
+//! EEPROM address of a profile slot (base 1), after the boot profile number
+#define slotAddress(x) (EEPROM_PROFILE_BASE + 1 + ((x) - 1) * sizeof(profileSlot))
+
+//! Size of the slot data protected by the CRC. The struct can be padded
+//! after the CRC so its offset is used instead of the struct size
+#define SLOT_CRC_SIZE offsetof(profileSlot, crc)
+
+boolean ProfileStore::save(int n, MotorControl &motor) {
+  profileSlot slot;
+
+  if( (n < 1) || (n > PROFILE_SLOTS) )
+    return false;
+
+  memset(&slot, 0, sizeof(profileSlot));
+  slot.magic = PROFILE_MAGIC;
+  slot.version = PROFILE_VERSION;
+  motor.getProfile(slot.data);
+  slot.crc = crc16((const uint8_t*)&slot, SLOT_CRC_SIZE);
+  EEPROM.put(slotAddress(n), slot);
+
+  return true;
+}
+
+boolean ProfileStore::load(int n, motorProfile &data) {
+  profileSlot slot;
+
+  if( (n < 1) || (n > PROFILE_SLOTS) || !readSlot(n, slot) )
+    return false;
+
+  data = slot.data;
+
+  return true;
+}
+
+boolean ProfileStore::setBoot(int n) {
+  if( (n < PROFILE_NONE) || (n > PROFILE_SLOTS) )
+    return false;
+
+  EEPROM.update(EEPROM_PROFILE_BASE, (uint8_t)n);
+
+  return true;
+}
+
+int ProfileStore::getBoot(void) {
+  uint8_t n;
+
+  // An erased EEPROM reads as an invalid number
+  n = EEPROM.read(EEPROM_PROFILE_BASE);
+  if(n > PROFILE_SLOTS)
+    return PROFILE_NONE;
+
+  return n;
+}
+
+void ProfileStore::showInfo(void) {
+  int j;
+  profileSlot slot;
+  Print &out = console.bulk();
+
+  out << PF_MSG_BOOT;
+  if(getBoot() == PROFILE_NONE)
+    out << PF_MSG_DEFAULTS;
+  else
+    out << getBoot();
+  out << endl;
+
+  for(j = 1; j <= PROFILE_SLOTS; j++) {
+    if(readSlot(j, slot))
+      out << PF_MSG_TITLE << j << endl;
+  }
+
+  out << PF_MSG_READY << bootTime << PF_MSG_CONFIG << configTime << endl;
+}
+
+boolean ProfileStore::readSlot(int n, profileSlot &slot) {
+  EEPROM.get(slotAddress(n), slot);
+
+  if( (slot.magic != PROFILE_MAGIC) || (slot.version != PROFILE_VERSION) )
+    return false;
+
+  return slot.crc == crc16((const uint8_t*)&slot, SLOT_CRC_SIZE);
+}
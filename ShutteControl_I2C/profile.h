@@ -0,0 +1,107 @@
+/**
+ *  \file profile.h
+ *  \brief Motors and PWM configuration profiles stored in the non volatile memory
+ *
+ *  A profile is a snapshot of the motor control settings. The boot profile,
+ *  if selected, is applied by MotorControl::begin() so the host does not
+ *  need to send again the configuration commands after every power up.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _PROFILE
+#define _PROFILE
+
+#include <Streaming.h>
+#include "motorcontrol.h"
+#include "storage.h"
+#include "console.h"
+
+#define PROFILE_SLOTS 3       ///< Number of profiles that can be stored (1-3)
+#define PROFILE_MAGIC 0x5A    ///< Marker of a used slot
+//! Layout version of the profile. Increase it when motorProfile changes:
+//! the profiles saved with a different version are ignored
+#define PROFILE_VERSION 2
+#define PROFILE_NONE 0        ///< No boot profile, the defaults are used
+
+#define PF_MSG_TITLE "Profile "
+#define PF_MSG_BOOT "boot "
+#define PF_MSG_SAVED " saved"
+#define PF_MSG_LOADED " loaded"
+#define PF_MSG_INVALID " invalid"
+#define PF_MSG_DEFAULTS "defaults"
+#define PF_MSG_READY "Ready (us) "
+#define PF_MSG_CONFIG " config (us) "
+
+/**
+ * Profile slot as saved in the EEPROM
+ */
+struct profileSlot {
+  uint8_t magic;          ///< PROFILE_MAGIC if the slot is in use
+  uint8_t version;        ///< PROFILE_VERSION when the profile has been saved
+  motorProfile data;      ///< Motors and PWM settings
+  uint16_t crc;           ///< CRC-16 of all the previous fields
+};
+
+/**
+ * \brief Save and load the configuration profiles
+ *
+ * The EEPROM area starts with the number of the boot profile followed
+ * by the profile slots.
+ */
+class ProfileStore {
+  public:
+
+    //! Time (us) from the power up to the end of the initialisation
+    unsigned long bootTime = 0;
+    //! Time (us) needed to configure the motor control on boot
+    unsigned long configTime = 0;
+
+    /**
+     * \brief Save the current settings in a profile
+     *
+     * \param n The profile number (1 to PROFILE_SLOTS)
+     * \param motor The motor control
+     * \return false if the profile number is not valid
+     */
+    boolean save(int n, MotorControl &motor);
+
+    /**
+     * \brief Read a profile
+     *
+     * \param n The profile number (1 to PROFILE_SLOTS)
+     * \param data The profile settings
+     * \return false if the profile does not exist or is not valid
+     */
+    boolean load(int n, motorProfile &data);
+
+    /**
+     * \brief Select the profile applied on boot
+     *
+     * \param n The profile number, PROFILE_NONE for the defaults
+     * \return false if the profile number is not valid
+     */
+    boolean setBoot(int n);
+
+    /**
+     * \brief Get the profile applied on boot
+     *
+     * \return The profile number, PROFILE_NONE if not set
+     */
+    int getBoot(void);
+
+    //! \brief Show the stored profiles and the boot times
+    void showInfo(void);
+
+  private:
+    /**
+     * \brief Read a slot from the EEPROM and check its integrity
+     *
+     * \param n The profile number
+     * \param slot The slot content
+     * \return true if the slot is in use, valid and of the current version
+     */
+    boolean readSlot(int n, profileSlot &slot);
+};
+
+#endif
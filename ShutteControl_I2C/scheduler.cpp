@@ -0,0 +1,82 @@
+/**
+ *  \file scheduler.cpp
+ *  \brief This file defines functions and predefined instances from scheduler.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "scheduler.h"
+
+void Scheduler::begin(schedTask* table, uint8_t n) {
+  int j;
+
+  tasks = table;
+  numTasks = n;
+
+  for(j = 0; j < numTasks; j++)
+    tasks[j].nextRun = millis() + tasks[j].period;
+
+  resetStats();
+}
+
+void Scheduler::run(void) {
+  int j;
+  long late;
+
+  for(j = 0; j < numTasks; j++) {
+    if(tasks[j].period == TASK_EVENT) {
+      execute(tasks[j]);
+      continue;
+    }
+
+    // Signed difference to survive the millis() rollover
+    late = (long)(millis() - tasks[j].nextRun);
+    if(late < 0)
+      continue;
+
+    if(late >= (long)tasks[j].period) {
+      tasks[j].misses++;
+      tasks[j].nextRun = millis() + tasks[j].period;
+    }
+    else
+      tasks[j].nextRun += tasks[j].period;
+
+    execute(tasks[j]);
+  }
+}
+
+void Scheduler::execute(schedTask &t) {
+  unsigned long start, elapsed;
+
+  start = micros();
+  t.run();
+  elapsed = micros() - start;
+
+  t.runs++;
+  if(elapsed > t.maxTime)
+    t.maxTime = elapsed;
+  if(elapsed > t.budget)
+    t.overruns++;
+}
+
+void Scheduler::resetStats(void) {
+  int j;
+
+  for(j = 0; j < numTasks; j++) {
+    tasks[j].runs = 0;
+    tasks[j].misses = 0;
+    tasks[j].overruns = 0;
+    tasks[j].maxTime = 0;
+  }
+}
+
+void Scheduler::showInfo(void) {
+  int j;
+  Print &out = console.bulk();
+
+  out << SCH_MSG_HEADER << endl;
+  for(j = 0; j < numTasks; j++) {
+    out << tasks[j].name << SCH_MSG_SEP << tasks[j].runs << SCH_MSG_SEP << tasks[j].misses <<
+      SCH_MSG_SEP << tasks[j].overruns << SCH_MSG_SEP << tasks[j].maxTime << endl;
+  }
+}
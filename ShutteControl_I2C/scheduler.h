@@ -0,0 +1,91 @@
+/**
+ *  \file scheduler.h
+ *  \brief Cooperative task scheduler of the main loop
+ *
+ *  The main loop work is split in tasks listed in a table in priority
+ *  order. Every pass of the scheduler runs the event tasks, that check
+ *  by themselves if there is something to do, and the periodic tasks
+ *  whose period is expired. The tasks never block for long: the time of
+ *  every run is measured and compared with the task budget.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _SCHEDULER
+#define _SCHEDULER
+
+#include <Streaming.h>
+#include "console.h"
+
+#define TASK_EVENT 0    ///< Period of the event tasks, run on every scheduler pass
+
+// Expected duration (us) of the main loop tasks
+#define TASK_BUDGET_SHUTTER_US 20000UL  ///< Shot at 1/1000, longer exposures are counted as overruns
+#define TASK_BUDGET_COMMAND_US 20000UL
+#define TASK_BUDGET_ADC_US 200UL
+#define TASK_BUDGET_RAMP_US 500UL
+#define TASK_BUDGET_DIAG_US 2000UL
+#define TASK_BUDGET_CONSOLE_US 2000UL
+
+#define SCH_MSG_HEADER "Task runs late overrun max(us)"
+#define SCH_MSG_SEP " "
+
+/**
+ * Task table entry
+ */
+struct schedTask {
+  const char* name;         ///< Task name shown in the statistics
+  void (*run)(void);        ///< Task function
+  unsigned int period;      ///< Period (ms) of a periodic task or TASK_EVENT
+  unsigned long budget;     ///< Max expected duration of a run (us)
+  unsigned long nextRun;    ///< Time of the next run of a periodic task (millis)
+  unsigned long runs;       ///< Number of runs
+  unsigned long misses;     ///< Runs started after the end of their period (deadline missed)
+  unsigned long overruns;   ///< Runs longer than the budget
+  unsigned long maxTime;    ///< Longest run (us)
+};
+
+/**
+ * \brief Run the tasks of a table in priority order
+ */
+class Scheduler {
+  public:
+
+    /**
+     * \brief Set the task table. The first task has the highest priority
+     *
+     * \param table The tasks table
+     * \param n The number of tasks
+     */
+    void begin(schedTask* table, uint8_t n);
+
+    /**
+     * \brief Execute a scheduler pass. Should be called by the main loop
+     *
+     * The tasks are run in the table order. A periodic task that has
+     * missed one or more periods runs once and is rescheduled one period
+     * after the current time.
+     */
+    void run(void);
+
+    //! \brief Reset the statistics of all the tasks
+    void resetStats(void);
+
+    //! \brief Show the statistics of the tasks
+    void showInfo(void);
+
+  private:
+    //! Tasks table
+    schedTask* tasks;
+    //! Number of tasks
+    uint8_t numTasks;
+
+    /**
+     * \brief Run a task measuring its duration
+     *
+     * \param t The task
+     */
+    void execute(schedTask &t);
+};
+
+#endif
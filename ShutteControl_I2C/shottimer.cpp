@@ -0,0 +1,123 @@
+/**
+ *  \file shottimer.cpp
+ *  \brief This file defines functions and predefined instances from shottimer.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "shottimer.h"
+
+#if defined(_SHOTTIMER_XMC)
+#include <string.h>
+#include <xmc_ccu4.h>
+#include <xmc_scu.h>
+
+#define SHOT_TIMER_SLICE CCU40_CC43
+#define SHOT_TIMER_SLICE_NUM 3
+#define SHOT_TIMER_IRQ CCU40_3_IRQn
+#endif
+
+ShotTimer shotTimer;
+
+void ShotTimer::begin(void) {
+#if defined(_SHOTTIMER_XMC)
+  XMC_CCU4_SLICE_COMPARE_CONFIG_t config;
+  uint32_t mhz;
+  uint8_t prescaler;
+
+  // 1 us ticks from the peripheral clock (power of 2 MHz)
+  mhz = XMC_SCU_CLOCK_GetPeripheralClockFrequency() / 1000000UL;
+  for(prescaler = 0; (1UL << prescaler) < mhz; prescaler++)
+    ;
+
+  memset(&config, 0, sizeof(config));
+  config.timer_mode = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA;
+  config.monoshot = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE;
+  config.prescaler_initval = prescaler;
+
+  XMC_CCU4_Init(CCU40, XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR);
+  XMC_CCU4_SLICE_CompareInit(SHOT_TIMER_SLICE, &config);
+  XMC_CCU4_SLICE_EnableEvent(SHOT_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+  XMC_CCU4_SLICE_SetInterruptNode(SHOT_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH,
+    XMC_CCU4_SLICE_SR_ID_3);
+  XMC_CCU4_EnableClock(CCU40, SHOT_TIMER_SLICE_NUM);
+  XMC_CCU4_StartPrescaler(CCU40);
+  NVIC_EnableIRQ(SHOT_TIMER_IRQ);
+#endif
+}
+
+void ShotTimer::start(unsigned long us, void (*fn)(void)) {
+  if(us == 0)
+    us = 1;
+
+  noInterrupts();
+  callback = fn;
+#if defined(_SHOTTIMER_XMC)
+  load(us);
+#else
+  startTime = micros();
+  delayUs = us;
+#endif
+  interrupts();
+}
+
+void ShotTimer::stop(void) {
+  noInterrupts();
+  callback = NULL;
+#if defined(_SHOTTIMER_XMC)
+  XMC_CCU4_SLICE_StopTimer(SHOT_TIMER_SLICE);
+  XMC_CCU4_SLICE_ClearEvent(SHOT_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+#endif
+  interrupts();
+}
+
+void ShotTimer::poll(void) {
+#if !defined(_SHOTTIMER_XMC)
+  if( (callback != NULL) && ((micros() - startTime) >= delayUs) ) {
+    remaining = 0;
+    expired();
+  }
+#endif
+}
+
+void ShotTimer::expired(void) {
+  void (*fn)(void);
+
+  if(remaining != 0) {
+    load(remaining);
+    return;
+  }
+
+  // The function can start the next delay
+  fn = callback;
+  callback = NULL;
+  if(fn != NULL)
+    fn();
+}
+
+void ShotTimer::load(unsigned long us) {
+#if defined(_SHOTTIMER_XMC)
+  unsigned long period;
+
+  period = (us > SHOT_TIMER_PERIOD_MAX) ? SHOT_TIMER_PERIOD_MAX : us;
+  remaining = us - period;
+
+  // The timer is stopped, the new period is transferred immediately
+  XMC_CCU4_SLICE_StopTimer(SHOT_TIMER_SLICE);
+  XMC_CCU4_SLICE_ClearTimer(SHOT_TIMER_SLICE);
+  XMC_CCU4_SLICE_SetTimerPeriodMatch(SHOT_TIMER_SLICE, (uint16_t)(period - 1));
+  XMC_CCU4_EnableShadowTransfer(CCU40, XMC_CCU4_SHADOW_TRANSFER_SLICE_3);
+  XMC_CCU4_SLICE_StartTimer(SHOT_TIMER_SLICE);
+#else
+  remaining = 0;
+  (void)us;
+#endif
+}
+
+#if defined(_SHOTTIMER_XMC)
+//! Period match of the timer slice
+extern "C" void CCU40_3_IRQHandler(void) {
+  XMC_CCU4_SLICE_ClearEvent(SHOT_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+  shotTimer.expired();
+}
+#endif
@@ -0,0 +1,82 @@
+/**
+ *  \file shottimer.h
+ *  \brief One shot timer for the trigger shot timing
+ *
+ *  The trigger shot is opened by the trigger interrupt and its steps (end
+ *  of the trigger output pulse, top window opening after the release delay,
+ *  top window closing after the exposure) are timed by this timer, so they
+ *  do not depend on the main loop or on the command being executed.
+ *
+ *  On the XMC the timer is the CCU40 slice 3 counting 1 us ticks, the
+ *  function is called by the period match interrupt; the delays longer
+ *  than the 16 bits counter are split. On the other architectures the
+ *  delay is polled by poll() and the function is called by the main loop.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _SHOTTIMER
+#define _SHOTTIMER
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_XMC) || defined(XMC1100_Series)
+#define _SHOTTIMER_XMC
+#endif
+
+//! Max ticks (us) of a single timer period
+#define SHOT_TIMER_PERIOD_MAX 60000UL
+
+/**
+ * \brief One shot timer calling a function after a delay
+ */
+class ShotTimer {
+  public:
+
+    //! \brief Initialise the timer hardware
+    void begin(void);
+
+    /**
+     * \brief Call a function after a delay. Replaces the running delay, can
+     * be called by the function itself to chain the steps
+     *
+     * \param us Delay (us), at least 1
+     * \param fn The function, called from the timer interrupt on the XMC
+     */
+    void start(unsigned long us, void (*fn)(void));
+
+    //! \brief Stop the running delay without calling its function
+    void stop(void);
+
+    //! \brief A delay is running
+    boolean isRunning(void) { return callback != NULL; }
+
+    //! \brief Call the function if the delay has elapsed. Used without
+    //! the hardware timer, should be called by the main loop
+    void poll(void);
+
+    //! \brief Period end, called by the timer interrupt
+    void expired(void);
+
+  private:
+    //! Function to call at the end of the delay, NULL if stopped
+    void (* volatile callback)(void) = NULL;
+    //! Delay (us) left after the running period
+    volatile unsigned long remaining;
+    //! Start time (micros) of the delay without the hardware timer
+    unsigned long startTime;
+    //! Delay (us) without the hardware timer
+    unsigned long delayUs;
+
+    /**
+     * \brief Start the next period of the delay
+     *
+     * \param us Delay (us) left
+     */
+    void load(unsigned long us);
+};
+
+//! Trigger shot timer instance
+extern ShotTimer shotTimer;
+
+#endif
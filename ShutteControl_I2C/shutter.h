@@ -19,6 +19,20 @@
 //! Shot signal marker pin. Test the shooting duration
 //! for test purpose only
 #define SHOT_MARK 4
+//! External trigger input pin (interrupt capable, active low)
+#define TRIGGER_IN 2
+//! Trigger output pin to chain other controllers (active low pulse, high when
+//! idle) so the chained inputs fire on the leading edge of the pulse
+#define TRIGGER_OUT 3
+//! Acknowledge interrupt output pin to the I2C master
+#define ACK_IRQ 7
+//! Trigger output pulse width (us)
+#define TRIGGER_PULSE_US 10
+//! Default delay (us) between the bottom window release and the top window
+//! opening. 0 changes both the windows in the same port write
+#define SH_RELEASE_US 1000
+//! Max release delay (us), longer delays should use the shutter window commands
+#define SH_RELEASE_MAX_US 16000
 //! Shutter motor ID
 #define SH_MOTOR 1
 //! Autofocus motor
@@ -27,10 +41,43 @@
 #define Z_MOTOR 3
 //! Motor cycle duration (ms)
 #define SH_MOTOR_MS 5
+//! Shutter end of travel input pin (active low), the microswitch or photo
+//! interrupter closes when the mechanism is cocked. The input is polled by the
+//! shutter motor cycle: D8 is the enable of the TLE94112 shield, and on the
+//! XMC1100 only pins 2 and 3 have interrupts, both used by the trigger
+#define SH_END_STOP 9
+//! Max shutter motor cycle duration (us) with the end of travel input,
+//! the motor is stopped anyway after this time
+#define SH_CYCLE_TIMEOUT_US (4000UL * SH_MOTOR_MS)
+//! End of travel edges before this time (us) from the cycle start are the
+//! switch bouncing while the mechanism leaves the cocked position
+#define SH_CYCLE_MIN_US 1000UL
+//! Shutter motor stop mode. The brake stops the mechanics at the end of the
+//! cycle so the next cycle of a burst can start immediately
+#define SH_STOP_MODE MOTOR_STOP_BRAKE
 //! PWM Min/Max duty cycle for the AF and ZOOM motors
 #define AF_MIN_DC 32
 #define AF_MAX_DC 128
 #define Z_MIN_DC 50
 #define Z_MAX_DC 255
 
+#define SH_MSG_CYCLES "Shutter cycles "
+#define SH_MSG_TIMEOUTS " timeouts "
+#define SH_MSG_LAST " last(us) "
+#define SH_MSG_MIN " min "
+#define SH_MSG_MAX " max "
+#define SH_MSG_AVG " avg "
+
+/**
+ * Shutter motor cycles statistics
+ */
+struct shutterCycle {
+  unsigned long count;      ///< Number of cycles
+  unsigned long timeouts;   ///< Cycles stopped by the timeout instead of the end of travel
+  unsigned long last;       ///< Duration (us) of the last cycle
+  unsigned long minTime;    ///< Shortest cycle (us)
+  unsigned long maxTime;    ///< Longest cycle (us)
+  unsigned long total;      ///< Sum of the cycles duration (us) for the average
+};
+
 #endif
@@ -0,0 +1,81 @@
+/**
+ *  \file stats.cpp
+ *  \brief This file defines functions and predefined instances from stats.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "stats.h"
+
+Stats stats;
+
+//! Diagnostic flags counted, in the faults counters order
+const uint8_t faultFlag[STATS_FAULTS] = {
+  Tle94112::TLE_SPI_ERROR, Tle94112::TLE_LOAD_ERROR, Tle94112::TLE_UNDER_VOLTAGE,
+  Tle94112::TLE_OVER_VOLTAGE, Tle94112::TLE_POWER_ON_RESET, Tle94112::TLE_TEMP_SHUTDOWN,
+  Tle94112::TLE_TEMP_WARNING
+};
+
+//! Diagnostic flags names
+const char* const faultName[STATS_FAULTS] = { "spi", "load", "uv", "ov", "por", "tsd", "tw" };
+
+//! Increment a counter without rolling over
+#define saturatedInc(x) { if((x) < 0xFFFF) (x)++; }
+
+void Stats::command(uint8_t id, unsigned long us) {
+  uint8_t bucket;
+
+  if(id >= CID_NUM)
+    return;
+
+  us >>= STATS_MIN_SHIFT;
+  for(bucket = 0; (us != 0) && (bucket < STATS_BUCKETS - 1); bucket++)
+    us >>= 1;
+
+  saturatedInc(count[id]);
+  saturatedInc(latency[id][bucket]);
+}
+
+void Stats::faults(uint8_t diagnosis) {
+  int j;
+
+  for(j = 0; j < STATS_FAULTS; j++) {
+    if(diagnosis & faultFlag[j])
+      saturatedInc(faultCount[j]);
+  }
+}
+
+void Stats::reset(void) {
+  spiWrites = 0;
+  spiReads = 0;
+  maxLoop = 0;
+  memset(count, 0, sizeof(count));
+  memset(latency, 0, sizeof(latency));
+  memset(faultCount, 0, sizeof(faultCount));
+}
+
+void Stats::showInfo(void) {
+  int j, k, last;
+  Print &out = console.bulk();
+
+  out << STATS_MSG_LOOP << maxLoop << STATS_MSG_SPI << spiWrites << STATS_MSG_READ << spiReads << endl;
+
+  out << STATS_MSG_FAULTS;
+  for(j = 0; j < STATS_FAULTS; j++) {
+    if(faultCount[j] != 0)
+      out << STATS_MSG_SEP << faultName[j] << "=" << faultCount[j];
+  }
+  out << endl;
+
+  // Command ID, executions, histogram up to the last bucket not empty
+  for(j = 0; j < CID_NUM; j++) {
+    if(count[j] == 0)
+      continue;
+    for(last = STATS_BUCKETS - 1; latency[j][last] == 0; last--)
+      ;
+    out << STATS_MSG_CMD << j << STATS_MSG_SEP << count[j] << STATS_MSG_HIST;
+    for(k = 0; k <= last; k++)
+      out << STATS_MSG_SEP << latency[j][k];
+    out << endl;
+  }
+}
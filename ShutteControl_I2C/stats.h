@@ -0,0 +1,94 @@
+/**
+ *  \file stats.h
+ *  \brief Runtime statistics of the commands, the TLE94112 and the main loop
+ *
+ *  The statistics are always collected, so the performance can be checked
+ *  on the field without an instrumented build:
+ *  - number of executions and latency histogram of every command ID;
+ *  - SPI writes and reads to the TLE94112;
+ *  - faults counted by diagnostic flag;
+ *  - longest main loop pass.
+ *
+ *  The latency histograms have log2 buckets: the bucket j counts the
+ *  executions lasting less than 2^(j + STATS_MIN_SHIFT) us, the last one
+ *  all the longer executions. The counters saturate instead of rolling over.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _STATS
+#define _STATS
+
+#include <Streaming.h>
+#include <TLE94112.h>
+#include "commands.h"
+#include "console.h"
+
+#define STATS_BUCKETS 16    ///< Latency histogram buckets
+#define STATS_MIN_SHIFT 5   ///< The first bucket counts the executions shorter than 32 us
+#define STATS_FAULTS 7      ///< Number of diagnostic flags counted
+
+#define STATS_MSG_LOOP "Stats loop max(us) "
+#define STATS_MSG_SPI " spi w "
+#define STATS_MSG_READ " r "
+#define STATS_MSG_FAULTS "Faults"
+#define STATS_MSG_CMD "Cmd "
+#define STATS_MSG_SEP " "
+#define STATS_MSG_HIST " |"
+
+/**
+ * \brief Statistics collector
+ */
+class Stats {
+  public:
+
+    //! SPI write transactions (half bridge, PWM and errors clear)
+    unsigned long spiWrites = 0;
+    //! SPI read transactions (diagnosis)
+    unsigned long spiReads = 0;
+    //! Longest main loop pass (us), low power sleep excluded
+    unsigned long maxLoop = 0;
+
+    /**
+     * \brief Count a command execution
+     *
+     * \param id The command ID
+     * \param us The execution time
+     */
+    void command(uint8_t id, unsigned long us);
+
+    /**
+     * \brief Count the faults of a diagnosis
+     *
+     * \param diagnosis The TLE94112 system diagnosis
+     */
+    void faults(uint8_t diagnosis);
+
+    //! \brief Count a main loop pass
+    inline void loop(unsigned long us) {
+      if(us > maxLoop)
+        maxLoop = us;
+    }
+
+    //! \brief Reset all the statistics
+    void reset(void);
+
+    /**
+     * \brief Show the statistics in compact format. Only the executed
+     * commands and the faults occurred are listed
+     */
+    void showInfo(void);
+
+  private:
+    //! Executions of every command ID
+    uint16_t count[CID_NUM];
+    //! Latency histograms of every command ID
+    uint16_t latency[CID_NUM][STATS_BUCKETS];
+    //! Faults by diagnostic flag
+    uint16_t faultCount[STATS_FAULTS];
+};
+
+//! Statistics instance
+extern Stats stats;
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ *  \file storage.cpp
+ *  \brief This file defines functions and predefined instances from storage.h
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "storage.h"
+
+uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc) {
+  int j;
+
+  while(len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for(j = 0; j < 8; j++) {
+      if(crc & 0x8000)
+        crc = (crc << 1) ^ 0x1021;
+      else
+        crc <<= 1;
+    }
+  }
+
+  return crc;
+}
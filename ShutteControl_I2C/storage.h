@@ -0,0 +1,36 @@
+/**
+ *  \file storage.h
+ *  \brief Non volatile memory layout and data integrity helpers
+ *  
+ *  All the data saved in the EEPROM are organised in fixed size slots
+ *  protected by a CRC-16 to detect empty or corrupted areas.
+ *  
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _STORAGE
+#define _STORAGE
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+//! Initial value of the CRC-16 (CCITT)
+#define CRC16_INIT 0xFFFF
+
+// EEPROM map. The macro slots are checked to fit in the area reserved here
+#define EEPROM_MACRO_BASE 0     ///< First address of the macro slots
+#define EEPROM_MACRO_SIZE 1024  ///< Bytes reserved to the macro slots
+//! First address of the configuration profiles, after the macro slots
+#define EEPROM_PROFILE_BASE (EEPROM_MACRO_BASE + EEPROM_MACRO_SIZE)
+
+/**
+ * \brief Calculate the CRC-16 CCITT (polynomial 0x1021) of a data block
+ * 
+ * \param data The data block
+ * \param len The block length in bytes
+ * \param crc The initial value, or the CRC of the previous block to chain
+ * \return The CRC value
+ */
+uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = CRC16_INIT);
+
+#endif
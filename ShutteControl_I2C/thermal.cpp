@@ -0,0 +1,68 @@
+/**
+ *  \file thermal.cpp
+ *  \brief This file defines functions and predefined instances from thermal.h
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#include "thermal.h"
+
+void ThermalGovernor::update(MotorControl &motor) {
+  int j;
+  unsigned long elapsed, load, maxLoad, onTime;
+  uint8_t prevLevel;
+
+  elapsed = millis() - lastUpdate;
+  if(elapsed < THERMAL_WINDOW_MS)
+    return;
+  lastUpdate = millis();
+
+  // Highest running time percentage of a motor in the window,
+  // the current run of the running motors included
+  maxLoad = 0;
+  for(j = 0; j < MAX_MOTORS; j++) {
+    onTime = motor.runningTime(j);
+    load = ((onTime - lastOnTime[j]) * 100) / elapsed;
+    if(load > maxLoad)
+      maxLoad = load;
+    lastOnTime[j] = onTime;
+  }
+
+  prevLevel = level;
+
+  if(motor.tempShutdowns != lastShutdowns)
+    level = THERMAL_MAX_LEVEL;
+  else if(motor.tempWarnings != lastWarnings) {
+    if(level < THERMAL_MAX_LEVEL)
+      level++;
+  }
+  else if( (maxLoad >= THERMAL_DUTY_HIGH) && (level == 0) )
+    level = 1;
+  else if( (maxLoad < THERMAL_DUTY_LOW) && (level > 0) )
+    level--;
+
+  lastWarnings = motor.tempWarnings;
+  lastShutdowns = motor.tempShutdowns;
+
+  if(level > 0)
+    throttled++;
+
+  if(level == prevLevel)
+    return;
+
+  // The running AF and zoom moves are throttled too
+  motor.setDCLimit(100 - level * THERMAL_DC_STEP);
+  CONSOLE_LOG(LOG_WARNING) << TH_MSG_TITLE << level << TH_MSG_PAUSE << framePause() <<
+    TH_MSG_DC << motor.dcLimit << endl;
+}
+
+void ThermalGovernor::showInfo(MotorControl &motor) {
+  int j;
+
+  CONSOLE_LOG(LOG_INFO) << TH_MSG_TITLE << level << TH_MSG_WARNINGS << motor.tempWarnings <<
+    TH_MSG_SHUTDOWNS << motor.tempShutdowns << TH_MSG_THROTTLED << throttled <<
+    TH_MSG_PAUSE << framePause() << TH_MSG_DC << motor.dcLimit << endl;
+
+  for(j = 0; j < MAX_MOTORS; j++)
+    CONSOLE_LOG(LOG_INFO) << TH_MSG_ONTIME << (j + 1) << " " << motor.runningTime(j) << endl;
+}
@@ -0,0 +1,82 @@
+/**
+ *  \file thermal.h
+ *  \brief Thermal governor for the TLE94112
+ *
+ *  Long bursts and timelapse sequences can heat the TLE94112 until the
+ *  temperature shutdown stops the motors in the middle of a sequence.
+ *  The governor checks the temperature warnings and the motors running
+ *  time on a fixed window and raises a throttling level: the timelapse
+ *  frames and the burst shots are spaced more and the PWM duty cycle of
+ *  the AF and zoom motors is reduced. The level decreases when the
+ *  chip is no longer warning and the motors load is low.
+ *
+ *  Licensed under GNU LGPL 3.0
+ */
+
+#ifndef _THERMAL
+#define _THERMAL
+
+#include <Streaming.h>
+#include "motorcontrol.h"
+#include "console.h"
+
+#define THERMAL_WINDOW_MS 5000      ///< Governor evaluation window (ms)
+#define THERMAL_MAX_LEVEL 4         ///< Max throttling level
+#define THERMAL_PAUSE_STEP_MS 100   ///< Additional pause between frames (ms) every level
+#define THERMAL_DC_STEP 15          ///< Duty cycle reduction (%) every level
+#define THERMAL_DUTY_HIGH 50        ///< Motor running time (% of the window) starting the throttling
+#define THERMAL_DUTY_LOW 20         ///< Motor running time (% of the window) to release a level
+
+#define TH_MSG_TITLE "Thermal level "
+#define TH_MSG_WARNINGS " warnings "
+#define TH_MSG_SHUTDOWNS " shutdowns "
+#define TH_MSG_THROTTLED " throttled windows "
+#define TH_MSG_PAUSE " pause (ms) "
+#define TH_MSG_DC " dc (%) "
+#define TH_MSG_ONTIME "On time (ms) M"
+
+/**
+ * \brief Throttling level depending on the TLE94112 temperature events
+ * and the motors load
+ */
+class ThermalGovernor {
+  public:
+
+    //! Current throttling level, 0 = no throttling
+    uint8_t level = 0;
+    //! Number of windows spent with a throttling level
+    unsigned int throttled = 0;
+
+    /**
+     * \brief Evaluate the last window and update the throttling level.
+     * Should be called by the main loop, the level is updated every
+     * THERMAL_WINDOW_MS
+     *
+     * \param motor The motor control, source of the events and target of the duty cycle limit
+     */
+    void update(MotorControl &motor);
+
+    //! \brief Additional pause (ms) between frames and shots at the current level
+    unsigned long framePause(void) {
+      return (unsigned long)level * THERMAL_PAUSE_STEP_MS;
+    }
+
+    /**
+     * \brief Show the throttling status and the motors running time
+     *
+     * \param motor The motor control
+     */
+    void showInfo(MotorControl &motor);
+
+  private:
+    //! Time of the last evaluation (millis)
+    unsigned long lastUpdate = 0;
+    //! Temperature warnings at the last evaluation
+    unsigned int lastWarnings = 0;
+    //! Temperature shutdowns at the last evaluation
+    unsigned int lastShutdowns = 0;
+    //! Motors running time at the last evaluation
+    unsigned long lastOnTime[MAX_MOTORS] = { 0 };
+};
+
+#endif